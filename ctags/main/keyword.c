@@ -24,52 +24,59 @@
 *   DATA DECLARATIONS
 */
 typedef struct sHashEntry {
-	struct sHashEntry *next;
-	const char *string;
-	langType language;
+	const char *string;  /* NULL for an empty slot */
+	unsigned int hash;
 	int value;
 } hashEntry;
 
+/* Each language has its own open addressing table with linear probing, so that
+ * lookups only ever compare against the keywords of the language being parsed.
+ * The size is a power of two and the table is kept at most half full. */
+typedef struct sKeywordHash {
+	hashEntry *entries;
+	unsigned int size;
+	unsigned int count;
+} keywordHash;
+
 /*
 *   DATA DEFINITIONS
 */
-static const unsigned int TableSize = 2039;  /* prime */
-static hashEntry **HashTable = NULL;
+static const unsigned int InitialTableSize = 64;
+static keywordHash *KeywordTables = NULL;  /* indexed by language */
+static unsigned int KeywordTableCount = 0;
 
 /*
 *   FUNCTION DEFINITIONS
 */
 
-static hashEntry **getHashTable (void)
+static keywordHash *getKeywordHash (langType language)
 {
-	static bool allocated = false;
-
-	if (! allocated)
-	{
-		unsigned int i;
-
-		HashTable = xMalloc (TableSize, hashEntry*);
-
-		for (i = 0  ;  i < TableSize  ;  ++i)
-			HashTable [i] = NULL;
-
-		allocated = true;
-	}
-	return HashTable;
+	if (language < 0 || (unsigned int) language >= KeywordTableCount)
+		return NULL;
+	return &KeywordTables [language];
 }
 
-static hashEntry *getHashTableEntry (unsigned long hashedValue)
+static keywordHash *allocKeywordHash (langType language)
 {
-	hashEntry **const table = getHashTable ();
-	hashEntry *entry;
+	Assert (language >= 0);
 
-	Assert (hashedValue < TableSize);
-	entry = table [hashedValue];
+	if ((unsigned int) language >= KeywordTableCount)
+	{
+		unsigned int i;
 
-	return entry;
+		KeywordTables = xRealloc (KeywordTables, language + 1, keywordHash);
+		for (i = KeywordTableCount  ;  i <= (unsigned int) language  ;  ++i)
+		{
+			KeywordTables [i].entries = NULL;
+			KeywordTables [i].size = 0;
+			KeywordTables [i].count = 0;
+		}
+		KeywordTableCount = language + 1;
+	}
+	return &KeywordTables [language];
 }
 
-static unsigned int hashValue (const char *const string, langType language)
+static unsigned int hashValue (const char *const string)
 {
 	const signed char *p;
 	unsigned int h = 5381;
@@ -80,23 +87,42 @@ static unsigned int hashValue (const char *const string, langType language)
 	for (p = (const signed char *)string; *p != '\0'; p++)
 		h = (h << 5) + h + *p;
 
-	/* consider language as an extra "character" and add it to the hash */
-	h = (h << 5) + h + language;
-
 	return h;
 }
 
-static hashEntry *newEntry (
-		const char *const string, langType language, int value)
+static hashEntry *findSlot (const keywordHash *const table,
+		const char *const string, unsigned int hash)
 {
-	hashEntry *const entry = xMalloc (1, hashEntry);
+	const unsigned int mask = table->size - 1;
+	unsigned int index = hash & mask;
 
-	entry->next     = NULL;
-	entry->string   = string;
-	entry->language = language;
-	entry->value    = value;
+	while (table->entries [index].string != NULL)
+	{
+		hashEntry *const entry = &table->entries [index];
 
-	return entry;
+		if (entry->hash == hash  &&  strcmp (string, entry->string) == 0)
+			return entry;
+		index = (index + 1) & mask;
+	}
+	return &table->entries [index];
+}
+
+static void resizeTable (keywordHash *const table, unsigned int size)
+{
+	hashEntry *const oldEntries = table->entries;
+	const unsigned int oldSize = table->size;
+	unsigned int i;
+
+	table->entries = xCalloc (size, hashEntry);
+	table->size = size;
+
+	for (i = 0  ;  i < oldSize  ;  ++i)
+	{
+		if (oldEntries [i].string != NULL)
+			*findSlot (table, oldEntries [i].string, oldEntries [i].hash) = oldEntries [i];
+	}
+	if (oldEntries != NULL)
+		eFree (oldEntries);
 }
 
 /*  Note that it is assumed that a "value" of zero means an undefined keyword
@@ -106,125 +132,92 @@ static hashEntry *newEntry (
  */
 extern void addKeyword (const char *const string, langType language, int value)
 {
-	const unsigned int index = hashValue (string, language) % TableSize;
-	hashEntry *entry = getHashTableEntry (index);
+	keywordHash *const table = allocKeywordHash (language);
+	const unsigned int hash = hashValue (string);
+	hashEntry *entry;
+
+	if (2 * (table->count + 1) > table->size)
+		resizeTable (table, table->size == 0 ? InitialTableSize : 2 * table->size);
 
-	if (entry == NULL)
+	entry = findSlot (table, string, hash);
+	if (entry->string != NULL)
 	{
-		hashEntry **const table = getHashTable ();
-		table [index] = newEntry (string, language, value);
+		Assert (("Already in table" == NULL));
+		return;
 	}
-	else
-	{
-		hashEntry *prev = NULL;
 
-		while (entry != NULL)
-		{
-			if (language == entry->language  &&
-				strcmp (string, entry->string) == 0)
-			{
-				Assert (("Already in table" == NULL));
-			}
-			prev = entry;
-			entry = entry->next;
-		}
-		if (entry == NULL)
-		{
-			Assert (prev != NULL);
-			prev->next = newEntry (string, language, value);
-		}
-	}
+	entry->string = string;
+	entry->hash   = hash;
+	entry->value  = value;
+	table->count++;
 }
 
 extern int lookupKeyword (const char *const string, langType language)
 {
-	const unsigned int index = hashValue (string, language) % TableSize;
-	hashEntry *entry = getHashTableEntry (index);
-	int result = -1;
+	const keywordHash *const table = getKeywordHash (language);
+	const hashEntry *entry;
 
-	while (entry != NULL)
-	{
-		if (language == entry->language  &&  strcmp (string, entry->string) == 0)
-		{
-			result = entry->value;
-			break;
-		}
-		entry = entry->next;
-	}
-	return result;
+	if (table == NULL  ||  table->count == 0)
+		return -1;
+
+	entry = findSlot (table, string, hashValue (string));
+	return entry->string != NULL ? entry->value : -1;
 }
 
 extern void freeKeywordTable (void)
 {
-	if (HashTable != NULL)
+	if (KeywordTables != NULL)
 	{
 		unsigned int i;
 
-		for (i = 0  ;  i < TableSize  ;  ++i)
+		for (i = 0  ;  i < KeywordTableCount  ;  ++i)
 		{
-			hashEntry *entry = HashTable [i];
-
-			while (entry != NULL)
-			{
-				hashEntry *next = entry->next;
-				eFree (entry);
-				entry = next;
-			}
+			if (KeywordTables [i].entries != NULL)
+				eFree (KeywordTables [i].entries);
 		}
-		eFree (HashTable);
+		eFree (KeywordTables);
+		KeywordTables = NULL;
+		KeywordTableCount = 0;
 	}
 }
 
 #ifdef DEBUG
 
-static void printEntry (const hashEntry *const entry)
+static void printTable (const keywordHash *const table, langType language)
 {
-	printf ("  %-15s %-7s\n", entry->string, getLanguageName (entry->language));
-}
+	unsigned long probes = 0;
+	unsigned int i;
 
-static unsigned int printBucket (const unsigned int i)
-{
-	hashEntry **const table = getHashTable ();
-	hashEntry *entry = table [i];
-	unsigned int measure = 1;
-	bool first = true;
-
-	printf ("%2d:", i);
-	if (entry == NULL)
-		printf ("\n");
-	else while (entry != NULL)
+	printf ("%s: %u keywords in %u slots\n", getLanguageName (language),
+			table->count, table->size);
+
+	for (i = 0  ;  i < table->size  ;  ++i)
 	{
-		if (! first)
-			printf ("    ");
-		else
+		const hashEntry *const entry = &table->entries [i];
+
+		if (entry->string != NULL)
 		{
-			printf (" ");
-			first = false;
+			/* number of slots visited when looking up this keyword */
+			const unsigned int home = entry->hash & (table->size - 1);
+
+			probes += ((i - home) & (table->size - 1)) + 1;
+			printf ("  %-15s %u\n", entry->string, i);
 		}
-		printEntry (entry);
-		entry = entry->next;
-		measure = 2 * measure;
 	}
-	return measure - 1;
+
+	if (table->count > 0)
+		printf ("  average probes = %.2f\n", (double) probes / table->count);
 }
 
 extern void printKeywordTable (void)
 {
-	unsigned long emptyBucketCount = 0;
-	unsigned long measure = 0;
 	unsigned int i;
 
-	for (i = 0  ;  i < TableSize  ;  ++i)
+	for (i = 0  ;  i < KeywordTableCount  ;  ++i)
 	{
-		const unsigned int pass = printBucket (i);
-
-		measure += pass;
-		if (pass == 0)
-			++emptyBucketCount;
+		if (KeywordTables [i].count > 0)
+			printTable (&KeywordTables [i], i);
 	}
-
-	printf ("spread measure = %ld\n", measure);
-	printf ("%ld empty buckets\n", emptyBucketCount);
 }
 
 #endif
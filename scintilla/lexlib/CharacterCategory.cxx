@@ -7,6 +7,8 @@
 // Copyright 2013 by Neil Hodgson <neilh@scintilla.org>
 // The License.txt file describes the conditions under which this software may be distributed.
 
+#include <vector>
+#include <map>
 #include <algorithm>
 
 #include "StringCopy.h"
@@ -3683,8 +3685,6 @@ const int maxUnicode = 0x10ffff;
 const int maskCategory = 0x1F;
 const int nRanges = ELEMENTS(catRanges);
 
-}
-
 // Each element in catRanges is the start of a range of Unicode characters in
 // one general category.
 // The value is comprised of a 21-bit character value shifted 5 bits and a 5 bit
@@ -3692,16 +3692,56 @@ const int nRanges = ELEMENTS(catRanges);
 // Initial version has 3249 entries and adds about 13K to the executable.
 // The array is in ascending order so can be searched using binary search.
 // Therefore the average call takes log2(3249) = 12 comparisons.
-// For speed, it may be useful to make a linear table for the common values,
-// possibly for 0..0xff for most Western European text or 0..0xfff for most
-// alphabetic languages.
+// Since lexers and word classification call this for every non-ASCII character,
+// catRanges is instead expanded once into a two-stage table making each call two
+// array lookups.
+
+// The first stage maps each block of 256 characters to the second stage block
+// holding their categories. Identical blocks, such as those of large ideograph or
+// unassigned ranges, are shared so the table takes about 43K.
+class CategoryTable {
+	static const int blockShift = 8;
+	static const int blockSize = 1 << blockShift;
+	std::vector<unsigned short> stage1;
+	std::vector<unsigned char> stage2;
+public:
+	CategoryTable() {
+		std::vector<unsigned char> categories(maxUnicode + 1);
+		for (int r = 0; r < nRanges; r++) {
+			const int start = catRanges[r] >> 5;
+			const int end = (r + 1 < nRanges) ? (catRanges[r + 1] >> 5) : (maxUnicode + 1);
+			std::fill(categories.begin() + start, categories.begin() + end,
+				static_cast<unsigned char>(catRanges[r] & maskCategory));
+		}
+		std::map<std::vector<unsigned char>, unsigned short> blocksSeen;
+		for (int blockStart = 0; blockStart <= maxUnicode; blockStart += blockSize) {
+			const std::vector<unsigned char> block(categories.begin() + blockStart,
+				categories.begin() + blockStart + blockSize);
+			const std::map<std::vector<unsigned char>, unsigned short>::const_iterator it =
+				blocksSeen.find(block);
+			if (it != blocksSeen.end()) {
+				stage1.push_back(it->second);
+			} else {
+				const unsigned short blockIndex = static_cast<unsigned short>(blocksSeen.size());
+				blocksSeen[block] = blockIndex;
+				stage1.push_back(blockIndex);
+				stage2.insert(stage2.end(), block.begin(), block.end());
+			}
+		}
+	}
+	CharacterCategory Category(int character) const {
+		const int blockIndex = stage1[character >> blockShift];
+		return static_cast<CharacterCategory>(stage2[(blockIndex << blockShift) + (character & (blockSize - 1))]);
+	}
+};
+
+}
 
 CharacterCategory CategoriseCharacter(int character) {
 	if (character < 0 || character > maxUnicode)
 		return ccCn;
-	const int baseValue = character * (maskCategory+1) + maskCategory;
-	const int *placeAfter = std::lower_bound(catRanges, catRanges+nRanges, baseValue);
-	return static_cast<CharacterCategory>(*(placeAfter-1) & maskCategory);
+	static const CategoryTable table;
+	return table.Category(character);
 }
 
 // Implementation of character sets recommended for identifiers in Unicode Standard Annex #31.
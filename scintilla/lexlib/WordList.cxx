@@ -64,7 +64,7 @@ static char **ArrayFromWordList(char *wordlist, int *len, bool onlyLineEnds = fa
 }
 
 WordList::WordList(bool onlyLineEnds_) :
-	words(0), list(0), len(0), onlyLineEnds(onlyLineEnds_) {
+	words(0), list(0), len(0), onlyLineEnds(onlyLineEnds_), hashTable(0), hashMask(0) {
 	// Prevent warnings by static analyzers about uninitialized starts.
 	starts[0] = -1;
 }
@@ -96,9 +96,42 @@ void WordList::Clear() {
 		delete []list;
 		delete []words;
 	}
+	delete []hashTable;
 	words = 0;
 	list = 0;
 	len = 0;
+	hashTable = 0;
+	hashMask = 0;
+}
+
+// FNV-1a hash of a NUL terminated word.
+static unsigned int HashWord(const char *s) {
+	unsigned int hash = 2166136261u;
+	for (; *s; s++) {
+		hash ^= static_cast<unsigned char>(*s);
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/**
+ * Builds a hash table over all words so exact matches in InList can be found with a
+ * single probe sequence instead of scanning every word with the same first character.
+ * The table is kept at most half full.
+ */
+void WordList::BuildHashTable() {
+	unsigned int size = 16;
+	while (size < static_cast<unsigned int>(len) * 2)
+		size *= 2;
+	hashTable = new int[size];
+	hashMask = size - 1;
+	std::fill(hashTable, hashTable + size, -1);
+	for (int i = 0; i < len; i++) {
+		unsigned int slot = HashWord(words[i]) & hashMask;
+		while (hashTable[slot] >= 0)
+			slot = (slot + 1) & hashMask;
+		hashTable[slot] = i;
+	}
 }
 
 #ifdef _MSC_VER
@@ -135,6 +168,7 @@ void WordList::Set(const char *s) {
 		unsigned char indexChar = words[l][0];
 		starts[indexChar] = l;
 	}
+	BuildHashTable();
 }
 
 /** Check whether a string is in the list.
@@ -145,24 +179,12 @@ void WordList::Set(const char *s) {
 bool WordList::InList(const char *s) const {
 	if (0 == words)
 		return false;
-	const unsigned char firstChar = s[0];
-	int j = starts[firstChar];
-	if (j >= 0) {
-		while (static_cast<unsigned char>(words[j][0]) == firstChar) {
-			if (s[1] == words[j][1]) {
-				const char *a = words[j] + 1;
-				const char *b = s + 1;
-				while (*a && *a == *b) {
-					a++;
-					b++;
-				}
-				if (!*a && !*b)
-					return true;
-			}
-			j++;
-		}
+	for (unsigned int slot = HashWord(s) & hashMask; hashTable[slot] >= 0; slot = (slot + 1) & hashMask) {
+		const char *word = words[hashTable[slot]];
+		if (word[0] == s[0] && strcmp(word, s) == 0)
+			return true;
 	}
-	j = starts[static_cast<unsigned int>('^')];
+	int j = starts[static_cast<unsigned int>('^')];
 	if (j >= 0) {
 		while (words[j][0] == '^') {
 			const char *a = words[j] + 1;
@@ -21,6 +21,9 @@ class WordList {
 	int len;
 	bool onlyLineEnds;	///< Delimited by any white space or only line ends
 	int starts[256];
+	int *hashTable;	///< Open addressing table of indices into words, -1 for empty slots
+	unsigned int hashMask;
+	void BuildHashTable();
 public:
 	explicit WordList(bool onlyLineEnds_ = false);
 	~WordList();
@@ -457,13 +457,29 @@ Sci::Line Document::GetLastChild(Sci::Line lineParent, int level, Sci::Line last
 	const Sci::Line maxLine = LinesTotal();
 	const Sci::Line lookLastLine = (lastLine != -1) ? std::min(LinesTotal() - 1, lastLine) : -1;
 	Sci::Line lineMaxSubord = lineParent;
-	while (lineMaxSubord < maxLine - 1) {
-		EnsureStyledTo(LineStart(lineMaxSubord + 2));
-		if (!IsSubordinate(level, GetLevel(lineMaxSubord + 1)))
-			break;
-		if ((lookLastLine != -1) && (lineMaxSubord >= lookLastLine) && !(GetLevel(lineMaxSubord) & SC_FOLDLEVELWHITEFLAG))
-			break;
-		lineMaxSubord++;
+	if (lookLastLine == -1) {
+		// Find the line ending the block with the levels index. Styling up to that line
+		// may change the levels before it so repeat until styling does not progress.
+		while (lineMaxSubord < maxLine - 1) {
+			const Sci::Line lineNotSubord = Levels()->FirstLineNotSubordinate(lineParent + 1, LevelNumber(level));
+			const Sci::Line lineEnd = ((lineNotSubord >= 0) && (lineNotSubord < maxLine)) ?
+				lineNotSubord : maxLine;
+			const Sci::Position endStyledBefore = GetEndStyled();
+			EnsureStyledTo(LineStart(std::min(lineEnd + 1, maxLine)));
+			if (GetEndStyled() == endStyledBefore) {
+				lineMaxSubord = lineEnd - 1;
+				break;
+			}
+		}
+	} else {
+		while (lineMaxSubord < maxLine - 1) {
+			EnsureStyledTo(LineStart(lineMaxSubord + 2));
+			if (!IsSubordinate(level, GetLevel(lineMaxSubord + 1)))
+				break;
+			if ((lineMaxSubord >= lookLastLine) && !(GetLevel(lineMaxSubord) & SC_FOLDLEVELWHITEFLAG))
+				break;
+			lineMaxSubord++;
+		}
 	}
 	if (lineMaxSubord > lineParent) {
 		if (level > LevelNumber(GetLevel(lineMaxSubord + 1))) {
@@ -477,20 +493,7 @@ Sci::Line Document::GetLastChild(Sci::Line lineParent, int level, Sci::Line last
 }
 
 Sci::Line Document::GetFoldParent(Sci::Line line) const {
-	const int level = LevelNumber(GetLevel(line));
-	Sci::Line lineLook = line - 1;
-	while ((lineLook > 0) && (
-	            (!(GetLevel(lineLook) & SC_FOLDLEVELHEADERFLAG)) ||
-	            (LevelNumber(GetLevel(lineLook)) >= level))
-	      ) {
-		lineLook--;
-	}
-	if ((GetLevel(lineLook) & SC_FOLDLEVELHEADERFLAG) &&
-	        (LevelNumber(GetLevel(lineLook)) < level)) {
-		return lineLook;
-	} else {
-		return -1;
-	}
+	return Levels()->LastHeaderBefore(line, LevelNumber(GetLevel(line)));
 }
 
 void Document::GetHighlightDelimiters(HighlightDelimiter &highlightDelimiter, Sci::Line line, Sci::Line lastLine) {
@@ -180,6 +180,8 @@ Editor::Editor() {
 	idleStyling = SC_IDLESTYLING_NONE;
 	needIdleStyling = false;
 
+	durationWrapOneLine = 0.00001;
+
 	modEventMask = SC_MODEVENTMASKALL;
 
 	pdoc->AddWatcher(this, 0);
@@ -1477,7 +1479,7 @@ bool Editor::WrapOneLine(Surface *surface, Sci::Line lineToWrap) {
 // Perform  wrapping for a subset of the lines needing wrapping.
 // wsAll: wrap all lines which need wrapping in this single call
 // wsVisible: wrap currently visible lines
-// wsIdle: wrap one page + 100 lines
+// wsIdle: wrap as many lines as fit in a short time slice, at least one page + 50 lines
 // Return true if wrapping occurred.
 bool Editor::WrapLines(WrapScope ws) {
 	Sci::Line goodTopLine = topLine;
@@ -1522,7 +1524,12 @@ bool Editor::WrapLines(WrapScope ws) {
 				return false;
 			}
 		} else if (ws == WrapScope::wsIdle) {
-			lineToWrapEnd = lineToWrap + LinesOnScreen() + 100;
+			// Try to keep time taken by wrapping reasonable so interaction remains smooth.
+			const double secondsAllowed = 0.01;
+			const Sci::Line linesInAllowedTime = Platform::Clamp(
+				static_cast<int>(secondsAllowed / durationWrapOneLine),
+				LinesOnScreen() + 50, 0x10000);
+			lineToWrapEnd = lineToWrap + linesInAllowedTime;
 		}
 		const Sci::Line lineEndNeedWrap = std::min(wrapPending.end, pdoc->LinesTotal());
 		lineToWrapEnd = std::min(lineToWrapEnd, lineEndNeedWrap);
@@ -1541,6 +1548,8 @@ bool Editor::WrapLines(WrapScope ws) {
 			if (surface) {
 //Platform::DebugPrintf("Wraplines: scope=%0d need=%0d..%0d perform=%0d..%0d\n", ws, wrapPending.start, wrapPending.end, lineToWrap, lineToWrapEnd);
 
+				const Sci::Line lineToWrapStart = lineToWrap;
+				ElapsedTime etWrapping;
 				while (lineToWrap < lineToWrapEnd) {
 					if (WrapOneLine(surface, lineToWrap)) {
 						wrapOccurred = true;
@@ -1548,6 +1557,7 @@ bool Editor::WrapLines(WrapScope ws) {
 					wrapPending.Wrapped(lineToWrap);
 					lineToWrap++;
 				}
+				WrapAdjustingLineDuration(etWrapping.Duration(), lineToWrap - lineToWrapStart);
 
 				goodTopLine = cs.DisplayFromDoc(lineDocTop) + std::min(subLineTop, cs.GetHeight(lineDocTop)-1);
 			}
@@ -1568,6 +1578,28 @@ bool Editor::WrapLines(WrapScope ws) {
 	return wrapOccurred;
 }
 
+void Editor::WrapAdjustingLineDuration(double durationWrapping, Sci::Line linesWrapped) {
+	// Place bounds on the duration used to avoid glitches spiking it
+	// and so causing slow wrapping or non-responsive scrolling
+	const double minDurationOneLine = 0.000001;
+	const double maxDurationOneLine = 0.0001;
+
+	// Alpha value for exponential smoothing.
+	// Most recent value contributes 25% to smoothed value.
+	const double alpha = 0.25;
+
+	if (linesWrapped >= 8) {
+		// Only adjust for wrapping multiple lines to avoid instability
+		const double durationOneLine = durationWrapping / linesWrapped;
+		durationWrapOneLine = alpha * durationOneLine + (1.0 - alpha) * durationWrapOneLine;
+		if (durationWrapOneLine < minDurationOneLine) {
+			durationWrapOneLine = minDurationOneLine;
+		} else if (durationWrapOneLine > maxDurationOneLine) {
+			durationWrapOneLine = maxDurationOneLine;
+		}
+	}
+}
+
 void Editor::LinesJoin() {
 	if (!RangeContainsProtected(targetStart, targetEnd)) {
 		UndoGroup ug(pdoc);
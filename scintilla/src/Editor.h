@@ -253,6 +253,7 @@ protected:	// ScintillaBase subclass needs access to much of Editor
 
 	// Wrapping support
 	WrapPending wrapPending;
+	double durationWrapOneLine;
 
 	bool convertPastes;
 
@@ -373,6 +374,7 @@ protected:	// ScintillaBase subclass needs access to much of Editor
 	bool WrapOneLine(Surface *surface, Sci::Line lineToWrap);
 	enum class WrapScope {wsAll, wsVisible, wsIdle};
 	bool WrapLines(WrapScope ws);
+	void WrapAdjustingLineDuration(double durationWrapping, Sci::Line linesWrapped);
 	void LinesJoin();
 	void LinesSplit(int pixelWidth);
 
@@ -6,6 +6,7 @@
 // The License.txt file describes the conditions under which this software may be distributed.
 
 #include <cstddef>
+#include <climits>
 #include <cassert>
 #include <cstring>
 
@@ -190,17 +191,37 @@ void LineMarkers::DeleteMarkFromHandle(int markerHandle) {
 	}
 }
 
+namespace {
+
+// Number of lines summarised by each leaf of the levels index
+const Sci::Line levelsBlockSize = 64;
+const int keyNone = INT_MAX;
+
+// Key used to find the end of a fold block: whitespace lines never end a block
+inline int SubordinateKey(int level) {
+	return (level & SC_FOLDLEVELWHITEFLAG) ? keyNone : (level & SC_FOLDLEVELNUMBERMASK);
+}
+
+// Key used to find the parent of a line: only header lines can be parents
+inline int HeaderKey(int level) {
+	return (level & SC_FOLDLEVELHEADERFLAG) ? (level & SC_FOLDLEVELNUMBERMASK) : keyNone;
+}
+
+}
+
 LineLevels::~LineLevels() {
 }
 
 void LineLevels::Init() {
 	levels.DeleteAll();
+	InvalidateIndex();
 }
 
 void LineLevels::InsertLine(Sci::Line line) {
 	if (levels.Length()) {
 		int level = (line < levels.Length()) ? levels[line] : SC_FOLDLEVELBASE;
 		levels.InsertValue(line, 1, level);
+		InvalidateIndex();
 	}
 }
 
@@ -214,15 +235,18 @@ void LineLevels::RemoveLine(Sci::Line line) {
 			levels[line-1] &= ~SC_FOLDLEVELHEADERFLAG;
 		else if (line > 0)
 			levels[line-1] |= firstHeader;
+		InvalidateIndex();
 	}
 }
 
 void LineLevels::ExpandLevels(Sci::Line sizeNew) {
 	levels.InsertValue(levels.Length(), sizeNew - levels.Length(), SC_FOLDLEVELBASE);
+	InvalidateIndex();
 }
 
 void LineLevels::ClearLevels() {
 	levels.DeleteAll();
+	InvalidateIndex();
 }
 
 int LineLevels::SetLevel(Sci::Line line, int level, Sci::Line lines) {
@@ -234,6 +258,7 @@ int LineLevels::SetLevel(Sci::Line line, int level, Sci::Line lines) {
 		prev = levels[line];
 		if (prev != level) {
 			levels[line] = level;
+			MarkChanged(line);
 		}
 	}
 	return prev;
@@ -247,6 +272,150 @@ int LineLevels::GetLevel(Sci::Line line) const {
 	}
 }
 
+void LineLevels::InvalidateIndex() {
+	indexValid = false;
+	dirtyBlocks.clear();
+}
+
+void LineLevels::MarkChanged(Sci::Line line) {
+	if (!indexValid)
+		return;
+	const Sci::Line block = line / levelsBlockSize;
+	if (dirtyBlocks.empty() || (dirtyBlocks.back() != block)) {
+		// When much of the document changes, such as after folding it all, rebuilding is cheaper
+		if (dirtyBlocks.size() >= std::max(leaves / 8, static_cast<size_t>(16))) {
+			InvalidateIndex();
+		} else {
+			dirtyBlocks.push_back(block);
+		}
+	}
+}
+
+LineLevels::BlockKeys LineLevels::KeysOfBlock(Sci::Line block) const {
+	BlockKeys keys = { keyNone, keyNone };
+	const Sci::Line lineEnd = std::min((block + 1) * levelsBlockSize, levels.Length());
+	for (Sci::Line line = block * levelsBlockSize; line < lineEnd; line++) {
+		const int level = levels[line];
+		keys.subordinate = std::min(keys.subordinate, SubordinateKey(level));
+		keys.header = std::min(keys.header, HeaderKey(level));
+	}
+	return keys;
+}
+
+void LineLevels::RepairBlock(Sci::Line block) {
+	size_t node = leaves + block;
+	index[node] = KeysOfBlock(block);
+	for (node /= 2; node > 0; node /= 2) {
+		index[node].subordinate = std::min(index[node * 2].subordinate, index[node * 2 + 1].subordinate);
+		index[node].header = std::min(index[node * 2].header, index[node * 2 + 1].header);
+	}
+}
+
+void LineLevels::RefreshIndex() {
+	if (!indexValid) {
+		const Sci::Line blocks = (levels.Length() + levelsBlockSize - 1) / levelsBlockSize;
+		leaves = 1;
+		while (leaves < static_cast<size_t>(blocks))
+			leaves *= 2;
+		const BlockKeys keysNone = { keyNone, keyNone };
+		index.assign(leaves * 2, keysNone);
+		for (Sci::Line block = 0; block < blocks; block++) {
+			index[leaves + block] = KeysOfBlock(block);
+		}
+		for (size_t node = leaves - 1; node > 0; node--) {
+			index[node].subordinate = std::min(index[node * 2].subordinate, index[node * 2 + 1].subordinate);
+			index[node].header = std::min(index[node * 2].header, index[node * 2 + 1].header);
+		}
+		indexValid = true;
+	} else {
+		for (const Sci::Line block : dirtyBlocks) {
+			RepairBlock(block);
+		}
+	}
+	dirtyBlocks.clear();
+}
+
+// Find the first block at or after blockStart with a key not greater than maxKey.
+Sci::Line LineLevels::FirstBlock(size_t node, Sci::Line nodeFirst, Sci::Line nodeLast,
+	Sci::Line blockStart, int BlockKeys::*key, int maxKey) const {
+	if ((nodeLast < blockStart) || (index[node].*key > maxKey))
+		return -1;
+	if (nodeFirst == nodeLast)
+		return nodeFirst;
+	const Sci::Line nodeMiddle = (nodeFirst + nodeLast) / 2;
+	const Sci::Line found = FirstBlock(node * 2, nodeFirst, nodeMiddle, blockStart, key, maxKey);
+	if (found >= 0)
+		return found;
+	return FirstBlock(node * 2 + 1, nodeMiddle + 1, nodeLast, blockStart, key, maxKey);
+}
+
+// Find the last block at or before blockEnd with a key not greater than maxKey.
+Sci::Line LineLevels::LastBlock(size_t node, Sci::Line nodeFirst, Sci::Line nodeLast,
+	Sci::Line blockEnd, int BlockKeys::*key, int maxKey) const {
+	if ((nodeFirst > blockEnd) || (index[node].*key > maxKey))
+		return -1;
+	if (nodeFirst == nodeLast)
+		return nodeFirst;
+	const Sci::Line nodeMiddle = (nodeFirst + nodeLast) / 2;
+	const Sci::Line found = LastBlock(node * 2 + 1, nodeMiddle + 1, nodeLast, blockEnd, key, maxKey);
+	if (found >= 0)
+		return found;
+	return LastBlock(node * 2, nodeFirst, nodeMiddle, blockEnd, key, maxKey);
+}
+
+// Find the first line at or after lineStart which is not whitespace and has a level number
+// not greater than levelNumber, so ending a fold block at that level.
+// Returns -1 when there is no such line.
+Sci::Line LineLevels::FirstLineNotSubordinate(Sci::Line lineStart, int levelNumber) {
+	const Sci::Line length = levels.Length();
+	// Lines without an entry have the base level
+	const Sci::Line lineBeyond = (SC_FOLDLEVELBASE <= levelNumber) ? std::max(lineStart, length) : -1;
+	if (lineStart >= length)
+		return lineBeyond;
+	RefreshIndex();
+	const Sci::Line blockStart = lineStart / levelsBlockSize;
+	const Sci::Line lineEndStart = std::min((blockStart + 1) * levelsBlockSize, length);
+	for (Sci::Line line = lineStart; line < lineEndStart; line++) {
+		if (SubordinateKey(levels[line]) <= levelNumber)
+			return line;
+	}
+	const Sci::Line block = FirstBlock(1, 0, leaves - 1, blockStart + 1,
+		&BlockKeys::subordinate, levelNumber);
+	if (block >= 0) {
+		const Sci::Line lineEnd = std::min((block + 1) * levelsBlockSize, length);
+		for (Sci::Line line = block * levelsBlockSize; line < lineEnd; line++) {
+			if (SubordinateKey(levels[line]) <= levelNumber)
+				return line;
+		}
+	}
+	return lineBeyond;
+}
+
+// Find the last header line before line with a level number less than levelNumber.
+// Returns -1 when there is no such line.
+Sci::Line LineLevels::LastHeaderBefore(Sci::Line line, int levelNumber) {
+	const Sci::Line lineEnd = std::min(line, levels.Length());
+	if (lineEnd <= 0)
+		return -1;
+	RefreshIndex();
+	const Sci::Line blockEnd = (lineEnd - 1) / levelsBlockSize;
+	for (Sci::Line lineLook = lineEnd - 1; lineLook >= blockEnd * levelsBlockSize; lineLook--) {
+		if (HeaderKey(levels[lineLook]) < levelNumber)
+			return lineLook;
+	}
+	if (blockEnd > 0) {
+		const Sci::Line block = LastBlock(1, 0, leaves - 1, blockEnd - 1,
+			&BlockKeys::header, levelNumber - 1);
+		if (block >= 0) {
+			for (Sci::Line lineLook = (block + 1) * levelsBlockSize - 1; lineLook >= block * levelsBlockSize; lineLook--) {
+				if (HeaderKey(levels[lineLook]) < levelNumber)
+					return lineLook;
+			}
+		}
+	}
+	return -1;
+}
+
 LineState::~LineState() {
 }
 
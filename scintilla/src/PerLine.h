@@ -67,10 +67,35 @@ public:
 	Sci::Line LineFromHandle(int markerHandle);
 };
 
+/**
+ * Fold levels of each line.
+ * Fold structure queries are answered with an index over blocks of lines: a tree holding for
+ * each range of blocks the minimum level number of non-whitespace lines and of header lines.
+ * The index is rebuilt lazily after lines are inserted or removed and blocks are repaired
+ * individually after levels change.
+ */
 class LineLevels : public PerLine {
+	struct BlockKeys {
+		int subordinate;	///< Minimum level number of non-whitespace lines
+		int header;	///< Minimum level number of header lines
+	};
 	SplitVector<int> levels;
+	std::vector<BlockKeys> index;
+	size_t leaves;
+	bool indexValid;
+	std::vector<Sci::Line> dirtyBlocks;
+
+	void InvalidateIndex();
+	void MarkChanged(Sci::Line line);
+	BlockKeys KeysOfBlock(Sci::Line block) const;
+	void RepairBlock(Sci::Line block);
+	void RefreshIndex();
+	Sci::Line FirstBlock(size_t node, Sci::Line nodeFirst, Sci::Line nodeLast,
+		Sci::Line blockStart, int BlockKeys::*key, int maxKey) const;
+	Sci::Line LastBlock(size_t node, Sci::Line nodeFirst, Sci::Line nodeLast,
+		Sci::Line blockEnd, int BlockKeys::*key, int maxKey) const;
 public:
-	LineLevels() {
+	LineLevels() : leaves(0), indexValid(false) {
 	}
 	// Deleted so Worker objects can not be copied.
 	LineLevels(const LineLevels &) = delete;
@@ -84,6 +109,8 @@ public:
 	void ClearLevels();
 	int SetLevel(Sci::Line line, int level, Sci::Line lines);
 	int GetLevel(Sci::Line line) const;
+	Sci::Line FirstLineNotSubordinate(Sci::Line lineStart, int levelNumber);
+	Sci::Line LastHeaderBefore(Sci::Line line, int levelNumber);
 };
 
 class LineState : public PerLine {
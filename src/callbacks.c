@@ -448,6 +448,7 @@ static void on_notebook1_switch_page_after(GtkNotebook *notebook, gpointer page,
 		guint page_num, gpointer user_data)
 {
 	GeanyDocument *doc;
+	guint i;
 
 	if (G_UNLIKELY(main_status.opening_session_files || main_status.closing_all))
 		return;
@@ -465,6 +466,9 @@ static void on_notebook1_switch_page_after(GtkNotebook *notebook, gpointer page,
 		build_menu_update(doc);
 		sidebar_update_tag_list(doc, FALSE);
 		document_highlight_tags(doc);
+		/* give the new current document a full layout cache and release the others' */
+		foreach_document(i)
+			editor_update_layout_cache(documents[i]->editor);
 
 		document_check_disk_status(doc, TRUE);
 
@@ -736,7 +740,7 @@ static void on_use_auto_indentation1_toggled(GtkCheckMenuItem *checkmenuitem, gp
 }
 
 
-static void find_usage(gboolean in_session)
+static void find_usage(gboolean in_session, gboolean in_workspace)
 {
 	GeanyFindFlags flags;
 	gchar *search_text;
@@ -757,20 +761,29 @@ static void find_usage(gboolean in_session)
 		flags = GEANY_FIND_MATCHCASE | GEANY_FIND_WHOLEWORD;
 	}
 
-	search_find_usage(search_text, search_text, flags, in_session);
+	if (in_workspace)
+		search_find_workspace_usage(search_text, search_text, flags);
+	else
+		search_find_usage(search_text, search_text, flags, in_session);
 	g_free(search_text);
 }
 
 
 void on_find_document_usage1_activate(GtkMenuItem *menuitem, gpointer user_data)
 {
-	find_usage(FALSE);
+	find_usage(FALSE, FALSE);
 }
 
 
 void on_find_usage1_activate(GtkMenuItem *menuitem, gpointer user_data)
 {
-	find_usage(TRUE);
+	find_usage(TRUE, FALSE);
+}
+
+
+void on_find_workspace_usage1_activate(GtkMenuItem *menuitem, gpointer user_data)
+{
+	find_usage(TRUE, TRUE);
 }
 
 
@@ -1313,6 +1326,7 @@ void on_menu_decrease_indent1_activate(GtkMenuItem *menuitem, gpointer user_data
 
 void on_next_message1_activate(GtkMenuItem *menuitem, gpointer user_data)
 {
+	msgwin_flush();
 	if (! ui_tree_view_find_next(GTK_TREE_VIEW(msgwindow.tree_msg),
 		msgwin_goto_messages_file_line))
 		ui_set_statusbar(FALSE, _("No more message items."));
@@ -1321,6 +1335,7 @@ void on_next_message1_activate(GtkMenuItem *menuitem, gpointer user_data)
 
 void on_previous_message1_activate(GtkMenuItem *menuitem, gpointer user_data)
 {
+	msgwin_flush();
 	if (! ui_tree_view_find_previous(GTK_TREE_VIEW(msgwindow.tree_msg),
 		msgwin_goto_messages_file_line))
 		ui_set_statusbar(FALSE, _("No more message items."));
@@ -1442,7 +1457,7 @@ void on_remove_markers1_activate(GtkMenuItem *menuitem, gpointer user_data)
 
 	sci_marker_delete_all(doc->editor->sci, 0);	/* delete the yellow tag marker */
 	sci_marker_delete_all(doc->editor->sci, 1);	/* delete user markers */
-	editor_indicator_clear(doc->editor, GEANY_INDICATOR_SEARCH);
+	search_mark_all(doc, NULL, 0);	/* also stops marking in the background */
 }
 
 
@@ -1677,6 +1692,7 @@ static void on_search1_activate(GtkMenuItem *menuitem, gpointer user_data)
 	gboolean have_messages;
 
 	/* enable commands if the messages window has any items */
+	msgwin_flush();
 	have_messages = gtk_tree_model_iter_n_children(GTK_TREE_MODEL(msgwindow.store_msg),
 		NULL) > 0;
 
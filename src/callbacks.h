@@ -169,6 +169,8 @@ void on_close_other_documents1_activate(GtkMenuItem *menuitem, gpointer user_dat
 
 void on_find_document_usage1_activate(GtkMenuItem *menuitem, gpointer user_data);
 
+void on_find_workspace_usage1_activate(GtkMenuItem *menuitem, gpointer user_data);
+
 void on_send_selection_to_vte1_activate(GtkMenuItem *menuitem, gpointer user_data);
 
 void on_plugin_preferences1_activate(GtkMenuItem *menuitem, gpointer user_data);
@@ -88,6 +88,16 @@
 GeanyFilePrefs file_prefs;
 GPtrArray *documents_array = NULL;
 
+/* documents by the key returned by get_filename_key() of their file_name and real_path */
+static GHashTable *file_name_index = NULL;
+static GHashTable *real_path_index = NULL;
+
+/* how long and for how many files get_real_path_from_utf8() keeps results */
+#define REAL_PATH_CACHE_TIMEOUT (2 * G_USEC_PER_SEC)
+#define REAL_PATH_CACHE_SIZE 256
+static GHashTable *real_path_cache = NULL;
+static gint64 real_path_cache_time = 0;
+
 
 /* an undo action, also used for redo actions */
 typedef struct
@@ -122,6 +132,165 @@ static GtkWidget* document_show_message(GeanyDocument *doc, GtkMessageType msgty
 	const gchar *extra_text, const gchar *format, ...) G_GNUC_PRINTF(11, 12);
 
 
+/* Returns the key @a filename is indexed by, which compares like utils_filenamecmp() */
+static gchar *get_filename_key(const gchar *filename)
+{
+#ifdef G_OS_WIN32
+	gchar *key;
+
+	if (g_utf8_validate(filename, -1, NULL))
+		return g_utf8_strdown(filename, -1);
+
+	key = g_locale_to_utf8(filename, -1, NULL, NULL, NULL);
+	if (key != NULL)
+		SETPTR(key, g_utf8_strdown(key, -1));
+	else
+		key = g_strdup(filename);
+	return key;
+#else
+	return g_strdup(filename);
+#endif
+}
+
+
+static gchar **get_index_key(GeanyDocument *doc, gboolean real_path)
+{
+	return real_path ? &doc->priv->index_real_path : &doc->priv->index_file_name;
+}
+
+
+static void document_index_add(GHashTable *index, GeanyDocument *doc, const gchar *filename,
+		gboolean real_path)
+{
+	gchar **key = get_index_key(doc, real_path);
+
+	g_return_if_fail(*key == NULL);
+
+	if (filename == NULL)
+		return;
+
+	*key = get_filename_key(filename);
+	/* like the linear search used to, prefer the document which was there first */
+	if (! g_hash_table_contains(index, *key))
+		g_hash_table_insert(index, g_strdup(*key), doc);
+}
+
+
+static void document_index_remove(GHashTable *index, GeanyDocument *doc, gboolean real_path)
+{
+	gchar **key = get_index_key(doc, real_path);
+	guint i;
+
+	if (*key == NULL)
+		return;
+
+	if (g_hash_table_lookup(index, *key) == doc)
+	{
+		g_hash_table_remove(index, *key);
+
+		/* another document can have the same name, e.g. when opened by a plugin */
+		foreach_document(i)
+		{
+			const gchar *other_key = *get_index_key(documents[i], real_path);
+
+			if (documents[i] != doc && other_key != NULL && strcmp(other_key, *key) == 0)
+			{
+				g_hash_table_insert(index, g_strdup(other_key), documents[i]);
+				break;
+			}
+		}
+	}
+	g_free(*key);
+	*key = NULL;
+}
+
+
+static void clear_real_path_cache(void)
+{
+	if (real_path_cache != NULL)
+		g_hash_table_destroy(real_path_cache);
+	real_path_cache = NULL;
+}
+
+
+/* Call this whenever doc->file_name or doc->real_path change */
+static void document_index_update(GeanyDocument *doc)
+{
+	document_index_remove(file_name_index, doc, FALSE);
+	document_index_remove(real_path_index, doc, TRUE);
+	document_index_add(file_name_index, doc, doc->file_name, FALSE);
+	document_index_add(real_path_index, doc, doc->real_path, TRUE);
+	/* a file may have been created or renamed */
+	clear_real_path_cache();
+}
+
+
+static const gchar *get_indexed_name(GeanyDocument *doc, gboolean real_path)
+{
+	return real_path ? doc->real_path : doc->file_name;
+}
+
+
+static gboolean index_key_changed(GeanyDocument *doc, gboolean real_path)
+{
+	const gchar *key = *get_index_key(doc, real_path);
+	const gchar *name = get_indexed_name(doc, real_path);
+	gchar *new_key;
+	gboolean changed;
+
+	if (key == NULL || name == NULL)
+		return key != name;
+
+	new_key = get_filename_key(name);
+	changed = strcmp(key, new_key) != 0;
+	g_free(new_key);
+	return changed;
+}
+
+
+/* Updates the index if a plugin changed doc->file_name or doc->real_path directly.
+ * This is checked for the document after plugins could handle one of its signals and
+ * in the API functions plugins call after changing the name, so lookups needn't check
+ * the other documents. */
+static void document_index_check(GeanyDocument *doc)
+{
+	if (index_key_changed(doc, FALSE) || index_key_changed(doc, TRUE))
+		document_index_update(doc);
+}
+
+
+/* Finds the document indexed by @a filename. Plugins can set doc->file_name directly,
+ * so the index is rebuilt when it finds a document with another name, other changes
+ * are found by document_index_check(). */
+static GeanyDocument *lookup_document(GHashTable *index, const gchar *filename, gboolean real_path)
+{
+	GeanyDocument *doc;
+	const gchar *name;
+	guint i;
+#ifdef G_OS_WIN32
+	gchar *key = get_filename_key(filename);
+#else
+	const gchar *key = filename;
+#endif
+
+	doc = g_hash_table_lookup(index, key);
+	name = (doc != NULL) ? get_indexed_name(doc, real_path) : NULL;
+	if (doc != NULL && (! doc->is_valid || name == NULL || utils_filenamecmp(filename, name) != 0))
+	{
+		foreach_document(i)
+			document_index_update(documents[i]);
+
+		doc = g_hash_table_lookup(index, key);
+		if (doc != NULL && ! doc->is_valid)
+			doc = NULL;
+	}
+#ifdef G_OS_WIN32
+	g_free(key);
+#endif
+	return doc;
+}
+
+
 /**
  * Finds a document whose @c real_path field matches the given filename.
  *
@@ -138,34 +307,38 @@ static GtkWidget* document_show_message(GeanyDocument *doc, GtkMessageType msgty
 GEANY_API_SYMBOL
 GeanyDocument* document_find_by_real_path(const gchar *realname)
 {
-	guint i;
-
 	if (! realname)
 		return NULL;	/* file doesn't exist on disk */
 
-	for (i = 0; i < documents_array->len; i++)
-	{
-		GeanyDocument *doc = documents[i];
-
-		if (! doc->is_valid || ! doc->real_path)
-			continue;
-
-		if (utils_filenamecmp(realname, doc->real_path) == 0)
-		{
-			return doc;
-		}
-	}
-	return NULL;
+	return lookup_document(real_path_index, realname, TRUE);
 }
 
 
 /* dereference symlinks, /../ junk in path and return locale encoding */
 static gchar *get_real_path_from_utf8(const gchar *utf8_filename)
 {
-	gchar *locale_name = utils_get_locale_from_utf8(utf8_filename);
-	gchar *realname = utils_get_real_path(locale_name);
+	gchar *locale_name;
+	gchar *realname;
+	gint64 now = g_get_monotonic_time();
+
+	/* the same few names are looked up over and over by build output and navigation,
+	 * so realpath() results are remembered for a short while */
+	if (real_path_cache == NULL ||
+		now - real_path_cache_time > REAL_PATH_CACHE_TIMEOUT ||
+		g_hash_table_size(real_path_cache) >= REAL_PATH_CACHE_SIZE)
+	{
+		clear_real_path_cache();
+		real_path_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+		real_path_cache_time = now;
+	}
+	else if (g_hash_table_lookup_extended(real_path_cache, utf8_filename, NULL, (gpointer *) &realname))
+		return g_strdup(realname);
 
+	locale_name = utils_get_locale_from_utf8(utf8_filename);
+	realname = utils_get_real_path(locale_name);
 	g_free(locale_name);
+
+	g_hash_table_insert(real_path_cache, g_strdup(utf8_filename), g_strdup(realname));
 	return realname;
 }
 
@@ -184,7 +357,6 @@ static gchar *get_real_path_from_utf8(const gchar *utf8_filename)
 GEANY_API_SYMBOL
 GeanyDocument *document_find_by_filename(const gchar *utf8_filename)
 {
-	guint i;
 	GeanyDocument *doc;
 	gchar *realname;
 
@@ -192,18 +364,10 @@ GeanyDocument *document_find_by_filename(const gchar *utf8_filename)
 
 	/* First search GeanyDocument::file_name, so we can find documents with a
 	 * filename set but not saved on disk, like vcdiff produces */
-	for (i = 0; i < documents_array->len; i++)
-	{
-		doc = documents[i];
+	doc = lookup_document(file_name_index, utf8_filename, FALSE);
+	if (doc != NULL)
+		return doc;
 
-		if (! doc->is_valid || doc->file_name == NULL)
-			continue;
-
-		if (utils_filenamecmp(utf8_filename, doc->file_name) == 0)
-		{
-			return doc;
-		}
-	}
 	/* Now try matching based on the realpath(), which is unique per file on disk */
 	realname = get_real_path_from_utf8(utf8_filename);
 	doc = document_find_by_real_path(realname);
@@ -384,6 +548,8 @@ GeanyDocument *document_get_current(void)
 void document_init_doclist(void)
 {
 	documents_array = g_ptr_array_new();
+	file_name_index = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	real_path_index = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
 }
 
 
@@ -394,6 +560,9 @@ void document_finalize(void)
 	for (i = 0; i < documents_array->len; i++)
 		g_free(documents[i]);
 	g_ptr_array_free(documents_array, TRUE);
+	g_hash_table_destroy(file_name_index);
+	g_hash_table_destroy(real_path_index);
+	clear_real_path_cache();
 }
 
 
@@ -652,6 +821,7 @@ static GeanyDocument *document_create(const gchar *utf8_filename)
 	doc->id = ++doc_id_counter;
 	doc->index = new_idx;
 	doc->file_name = g_strdup(utf8_filename);
+	document_index_update(doc);
 	doc->editor = editor_create(doc);
 #ifndef USE_GIO_FILEMON
 	doc->priv->last_check = time(NULL);
@@ -735,6 +905,8 @@ static gboolean remove_page(guint page_num)
 	}
 	g_free(doc->encoding);
 	g_free(doc->priv->saved_encoding.encoding);
+	document_index_remove(file_name_index, doc, FALSE);
+	document_index_remove(real_path_index, doc, TRUE);
 	g_free(doc->file_name);
 	g_free(doc->real_path);
 	if (doc->tm_file)
@@ -886,6 +1058,7 @@ GeanyDocument *document_new_file(const gchar *utf8_filename, GeanyFiletype *ft,
 	g_signal_connect(doc->editor->sci, "sci-notify", G_CALLBACK(editor_sci_notify_cb), doc->editor);
 
 	g_signal_emit_by_name(geany_object, "document-new", doc);
+	document_index_check(doc);
 
 	msgwin_status_add(_("New file \"%s\" opened."),
 		DOC_FILENAME(doc));
@@ -1349,6 +1522,7 @@ GeanyDocument *document_open_file_full(GeanyDocument *doc, const gchar *filename
 
 			/* file exists on disk, set real_path */
 			SETPTR(doc->real_path, utils_get_real_path(locale_filename));
+			document_index_update(doc);
 
 			doc->priv->is_remote = utils_is_remote_path(locale_filename);
 			monitor_file_setup(doc);
@@ -1483,12 +1657,16 @@ GeanyDocument *document_open_file_full(GeanyDocument *doc, const gchar *filename
 
 		if (reload)
 		{
+			/* the reloaded text can be much bigger or smaller */
+			editor_update_layout_cache(doc->editor);
 			g_signal_emit_by_name(geany_object, "document-reload", doc);
+			document_index_check(doc);
 			ui_set_statusbar(TRUE, _("File %s reloaded."), display_filename);
 		}
 		else
 		{
 			g_signal_emit_by_name(geany_object, "document-open", doc);
+			document_index_check(doc);
 			/* For translators: this is the status window message for opening a file. %d is the number
 			 * of the newly opened file, %s indicates whether the file is opened read-only
 			 * (it is replaced with the string ", read-only"). */
@@ -1754,6 +1932,8 @@ void document_rename_file(GeanyDocument *doc, const gchar *new_filename)
 	document_stop_file_monitoring(doc);
 
 	result = g_rename(old_locale_filename, new_locale_filename);
+	/* the old name may be cached as a real path */
+	clear_real_path_cache();
 	if (result != 0)
 	{
 		dialogs_show_msgbox_with_secondary(GTK_MESSAGE_ERROR,
@@ -1822,6 +2002,7 @@ gboolean document_save_file_as(GeanyDocument *doc, const gchar *utf8_fname)
 
 	/* reset real path, it's retrieved again in document_save() */
 	SETPTR(doc->real_path, NULL);
+	document_index_update(doc);
 
 	/* detect filetype */
 	if (doc->file_type->id == GEANY_FILETYPES_NONE)
@@ -2142,6 +2323,7 @@ gboolean document_save_file(GeanyDocument *doc, gboolean force)
 
 	/* notify plugins which may wish to modify the document before it's saved */
 	g_signal_emit_by_name(geany_object, "document-before-save", doc);
+	document_index_check(doc);
 
 	len = sci_get_length(doc->editor->sci) + 1;
 	if (doc->has_bom && encodings_is_unicode_charset(doc->encoding))
@@ -2226,25 +2408,241 @@ gboolean document_save_file(GeanyDocument *doc, gboolean force)
 	}
 	g_free(locale_filename);
 
+	/* the real path may be new, or a plugin may have changed the file name */
+	document_index_update(doc);
 	g_signal_emit_by_name(geany_object, "document-save", doc);
+	document_index_check(doc);
 
 	return TRUE;
 }
 
 
+/* Amount of text to scan and number of known matches to check in each idle call
+ * when counting the matches of the search bar text */
+#define SEARCH_BAR_CHUNK_SIZE (256 * 1024)
+#define SEARCH_BAR_CHECK_COUNT 4096
+
+/* Matches of the last search bar text, counted in the background and reused
+ * while the text gets extended, see document_search_bar_find() */
+static struct
+{
+	GeanyDocument *doc;
+	guint doc_id;
+	gchar *text;
+	GArray *matches;	/* start positions of all (also overlapping) matches, sorted */
+	GArray *candidates;	/* matches of a prefix of text to check, or NULL to scan the document */
+	guint next;	/* next candidate to check */
+	gint pos;	/* where the document scan continues */
+	gboolean complete;
+	guint source_id;
+}
+search_bar_matches = {NULL, 0, NULL, NULL, NULL, 0, 0, FALSE, 0};
+
+
+static void search_bar_matches_reset(void)
+{
+	if (search_bar_matches.source_id != 0)
+	{
+		g_source_remove(search_bar_matches.source_id);
+		search_bar_matches.source_id = 0;
+	}
+	if (search_bar_matches.matches)
+		g_array_free(search_bar_matches.matches, TRUE);
+	if (search_bar_matches.candidates)
+		g_array_free(search_bar_matches.candidates, TRUE);
+	SETPTR(search_bar_matches.text, NULL);
+	search_bar_matches.matches = NULL;
+	search_bar_matches.candidates = NULL;
+	search_bar_matches.doc = NULL;
+	search_bar_matches.complete = FALSE;
+}
+
+
+/* Forgets the search bar matches of @a doc, e.g. because its text changed. */
+void document_search_bar_clear_matches(GeanyDocument *doc)
+{
+	if (search_bar_matches.doc == doc)
+		search_bar_matches_reset();
+}
+
+
+/* Returns all matches of @a text or of a prefix of it in @a doc if they are known,
+ * otherwise NULL. The matches of a text are a subset of the ones of its prefixes. */
+static GArray *search_bar_known_matches(GeanyDocument *doc, const gchar *text)
+{
+	if (search_bar_matches.doc != doc || doc->id != search_bar_matches.doc_id ||
+		! search_bar_matches.complete || ! g_str_has_prefix(text, search_bar_matches.text))
+		return NULL;
+
+	return search_bar_matches.matches;
+}
+
+
+/* Returns the index of the first position in the sorted @a positions at or after @a pos */
+static guint search_bar_lower_bound(GArray *positions, gint pos)
+{
+	guint low = 0, high = positions->len;
+
+	while (low < high)
+	{
+		guint mid = low + (high - low) / 2;
+
+		if (g_array_index(positions, gint, mid) < pos)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+
+static void search_bar_report_matches(gboolean complete)
+{
+	guint count = search_bar_matches.matches->len;
+
+	if (complete)
+		ui_set_statusbar(FALSE, ngettext("%u match for \"%s\".", "%u matches for \"%s\".", count),
+			count, search_bar_matches.text);
+	else
+		ui_set_statusbar(FALSE, _("%u matches for \"%s\" so far..."), count, search_bar_matches.text);
+}
+
+
+/* Checks whether the search bar text matches at @a pos, which is the start
+ * of a match of a prefix of it */
+static gboolean search_bar_matches_at(ScintillaObject *sci, gint pos, gint length)
+{
+	struct Sci_TextToFind ttf;
+
+	ttf.chrg.cpMin = pos;
+	/* allow for case variants of different length */
+	ttf.chrg.cpMax = MIN(length, pos + 3 * (gint) strlen(search_bar_matches.text));
+	ttf.lpstrText = search_bar_matches.text;
+	return sci_find_text(sci, 0, &ttf) == pos;
+}
+
+
+static gboolean search_bar_count_in_idle(gpointer data)
+{
+	GeanyDocument *doc = search_bar_matches.doc;
+	ScintillaObject *sci;
+	gint length;
+	gboolean done;
+
+	if (! DOC_VALID(doc) || doc->id != search_bar_matches.doc_id)
+	{
+		search_bar_matches.source_id = 0;
+		search_bar_matches_reset();
+		return FALSE;
+	}
+
+	sci = doc->editor->sci;
+	length = sci_get_length(sci);
+	if (search_bar_matches.candidates)
+	{
+		GArray *candidates = search_bar_matches.candidates;
+		guint end = MIN(search_bar_matches.next + SEARCH_BAR_CHECK_COUNT, candidates->len);
+
+		for (; search_bar_matches.next < end; search_bar_matches.next++)
+		{
+			gint pos = g_array_index(candidates, gint, search_bar_matches.next);
+
+			if (search_bar_matches_at(sci, pos, length))
+				g_array_append_val(search_bar_matches.matches, pos);
+		}
+		done = search_bar_matches.next >= candidates->len;
+	}
+	else
+	{
+		struct Sci_TextToFind ttf;
+		gint pos = search_bar_matches.pos;
+		gint limit = MIN(pos + SEARCH_BAR_CHUNK_SIZE, length);
+
+		/* also find matches starting before but ending after limit */
+		ttf.chrg.cpMax = MIN(length, limit + 3 * (gint) strlen(search_bar_matches.text));
+		ttf.lpstrText = search_bar_matches.text;
+		while (pos < limit)
+		{
+			gint start;
+
+			ttf.chrg.cpMin = pos;
+			start = sci_find_text(sci, 0, &ttf);
+			if (start < 0)
+			{
+				pos = limit;
+				break;
+			}
+			g_array_append_val(search_bar_matches.matches, start);
+			/* find overlapping matches too, they may be matches of an extended text */
+			pos = start + 1;
+		}
+		search_bar_matches.pos = pos;
+		done = pos >= length;
+	}
+
+	if (done)
+	{
+		search_bar_matches.source_id = 0;
+		search_bar_matches.complete = TRUE;
+		if (search_bar_matches.candidates)
+		{
+			g_array_free(search_bar_matches.candidates, TRUE);
+			search_bar_matches.candidates = NULL;
+		}
+	}
+	search_bar_report_matches(done);
+	return ! done;
+}
+
+
+/* Starts counting the matches of @a text in @a doc in the background, cancelling
+ * any previous count. The known matches of a prefix of @a text are only checked
+ * instead of scanning the whole document again. */
+static void search_bar_count_matches(GeanyDocument *doc, const gchar *text)
+{
+	GArray *candidates;
+
+	if (search_bar_matches.doc == doc && doc->id == search_bar_matches.doc_id &&
+		strcmp(text, search_bar_matches.text) == 0)
+	{
+		/* already counted or being counted */
+		if (search_bar_matches.complete)
+			search_bar_report_matches(TRUE);
+		return;
+	}
+	candidates = search_bar_known_matches(doc, text);
+	if (candidates != NULL)
+		search_bar_matches.matches = NULL;	/* keep them as candidates */
+	search_bar_matches_reset();
+
+	search_bar_matches.doc = doc;
+	search_bar_matches.doc_id = doc->id;
+	search_bar_matches.text = g_strdup(text);
+	search_bar_matches.matches = g_array_new(FALSE, FALSE, sizeof(gint));
+	search_bar_matches.candidates = candidates;
+	search_bar_matches.next = 0;
+	search_bar_matches.pos = 0;
+	search_bar_matches.source_id = g_idle_add(search_bar_count_in_idle, NULL);
+}
+
+
 /* special search function, used from the find entry in the toolbar
  * return TRUE if text was found otherwise FALSE
  * return also TRUE if text is empty  */
 gboolean document_search_bar_find(GeanyDocument *doc, const gchar *text, gboolean inc,
 		gboolean backwards)
 {
-	gint start_pos, search_pos;
+	gint start_pos, search_pos = -1;
 	struct Sci_TextToFind ttf;
+	GArray *known;
 
 	g_return_val_if_fail(text != NULL, FALSE);
 	g_return_val_if_fail(doc != NULL, FALSE);
 	if (! *text)
+	{
+		search_bar_matches_reset();
 		return TRUE;
+	}
 
 	start_pos = (inc || backwards) ? sci_get_selection_start(doc->editor->sci) :
 		sci_get_selection_end(doc->editor->sci);	/* equal if no selection */
@@ -2253,10 +2651,23 @@ gboolean document_search_bar_find(GeanyDocument *doc, const gchar *text, gboolea
 	ttf.chrg.cpMin = start_pos;
 	ttf.chrg.cpMax = backwards ? 0 : sci_get_length(doc->editor->sci);
 	ttf.lpstrText = (gchar *)text;
-	search_pos = sci_find_text(doc->editor->sci, 0, &ttf);
+
+	known = search_bar_known_matches(doc, text);
+	if (known != NULL && ! backwards)
+	{
+		guint i = search_bar_lower_bound(known, start_pos);
+
+		/* skip to the first possible match, or right to searching from the start */
+		if (i < known->len)
+			ttf.chrg.cpMin = g_array_index(known, gint, i);
+		else
+			ttf.chrg.cpMin = ttf.chrg.cpMax;
+	}
+	if (known == NULL || known->len > 0)
+		search_pos = sci_find_text(doc->editor->sci, 0, &ttf);
 
 	/* if no match, search start (or end) to cursor */
-	if (search_pos == -1)
+	if (search_pos == -1 && (known == NULL || known->len > 0))
 	{
 		if (backwards)
 		{
@@ -2270,6 +2681,7 @@ gboolean document_search_bar_find(GeanyDocument *doc, const gchar *text, gboolea
 		}
 		search_pos = sci_find_text(doc->editor->sci, 0, &ttf);
 	}
+	search_bar_count_matches(doc, text);
 
 	if (search_pos != -1)
 	{
@@ -2829,6 +3241,8 @@ void document_set_filetype(GeanyDocument *doc, GeanyFiletype *type)
 	if (type == NULL)
 		type = filetypes[GEANY_FILETYPES_NONE];
 
+	/* plugins often set doc->file_name before detecting the filetype again */
+	document_index_check(doc);
 	old_ft = doc->file_type;
 	geany_debug("%s : %s (%s)",
 		(doc->file_name != NULL) ? doc->file_name : "unknown",
@@ -2854,6 +3268,7 @@ void document_set_filetype(GeanyDocument *doc, GeanyFiletype *type)
 
 		sidebar_openfiles_update(doc); /* to update the icon */
 		g_signal_emit_by_name(geany_object, "document-filetype-set", doc, old_ft);
+		document_index_check(doc);
 	}
 }
 
@@ -3684,6 +4099,7 @@ static void monitor_resave_missing_file(GeanyDocument *doc)
 		document_set_text_changed(doc, TRUE);
 		/* don't prompt more than once */
 		SETPTR(doc->real_path, NULL);
+		document_index_update(doc);
 		doc->priv->info_bars[MSG_TYPE_RESAVE] = bar;
 		enable_key_intercept(doc, bar);
 	}
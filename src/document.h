@@ -283,6 +283,8 @@ void document_update_tags(GeanyDocument *doc);
 
 void document_update_tag_list_in_idle(GeanyDocument *doc);
 
+void document_search_bar_clear_matches(GeanyDocument *doc);
+
 void document_highlight_tags(GeanyDocument *doc);
 
 gboolean document_check_disk_status(GeanyDocument *doc, gboolean force);
@@ -113,6 +113,11 @@ typedef struct GeanyDocumentPrivate
 	GtkWidget		*info_bars[NUM_MSG_TYPES];
 	/* Keyed Data List to attach arbitrary data to the document */
 	GData			*data;
+	/* file_name and real_path as last added to the document lookup indexes */
+	gchar			*index_file_name;
+	gchar			*index_real_path;
+	/* whether the size changed enough to choose the layout cache level again */
+	gboolean		 layout_cache_outdated;
 }
 GeanyDocumentPrivate;
 
@@ -51,6 +51,7 @@
 #include "prefs.h"
 #include "projectprivate.h"
 #include "sciwrappers.h"
+#include "search.h"
 #include "support.h"
 #include "symbols.h"
 #include "templates.h"
@@ -506,6 +507,12 @@ static void on_update_ui(GeanyEditor *editor, G_GNUC_UNUSED SCNotification *nt)
 	ScintillaObject *sci = editor->sci;
 	gint pos = sci_get_current_position(sci);
 
+	if (editor->document->priv->layout_cache_outdated)
+	{
+		editor->document->priv->layout_cache_outdated = FALSE;
+		editor_update_layout_cache(editor);
+	}
+
 	/* since Scintilla 2.24, SCN_UPDATEUI is also sent on scrolling though we don't need to handle
 	 * this and so ignore every SCN_UPDATEUI events except for content and selection changes */
 	if (! (nt->updated & SC_UPDATE_CONTENT) && ! (nt->updated & SC_UPDATE_SELECTION))
@@ -1067,6 +1074,10 @@ void editor_sci_notify_cb(G_GNUC_UNUSED GtkWidget *widget, G_GNUC_UNUSED gint sc
 }
 
 
+/* Edits inserting or deleting at least this many characters on a single line re-evaluate
+ * the layout cache level, like edits adding or removing lines do */
+#define LAYOUT_CACHE_UPDATE_MIN_LENGTH 4096
+
 static gboolean on_editor_notify(G_GNUC_UNUSED GObject *object, GeanyEditor *editor,
 								 SCNotification *nt, G_GNUC_UNUSED gpointer data)
 {
@@ -1131,6 +1142,13 @@ static gboolean on_editor_notify(G_GNUC_UNUSED GObject *object, GeanyEditor *edi
 			if (nt->modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT))
 			{
 				document_update_tag_list_in_idle(doc);
+				document_search_bar_clear_matches(doc);
+				search_mark_all_text_changed(doc, nt->position, nt->length,
+					(nt->modificationType & SC_MOD_INSERTTEXT) != 0);
+				/* keep the layout cache within its budget as the document grows or shrinks,
+				 * the level is changed in on_update_ui() rather than while notifying */
+				if (nt->linesAdded != 0 || nt->length >= LAYOUT_CACHE_UPDATE_MIN_LENGTH)
+					doc->priv->layout_cache_outdated = TRUE;
 			}
 			break;
 
@@ -5198,6 +5216,58 @@ void editor_apply_update_prefs(GeanyEditor *editor)
 	sci_set_scroll_stop_at_last_line(sci, editor_prefs.scroll_stop_at_last_line);
 
 	sci_set_scrollbar_mode(sci, editor_prefs.show_scrollbars);
+
+	editor_update_layout_cache(editor);
+}
+
+
+/* Rough estimate of the memory used by a cached line layout, per character and per line */
+#define LAYOUT_CACHE_BYTES_PER_CHAR 12
+#define LAYOUT_CACHE_BYTES_PER_LINE 160
+/* Percentage of the budget a document caching only its visible page must shrink to before it
+ * caches all its lines again, so that a document near the budget doesn't keep switching */
+#define LAYOUT_CACHE_BUDGET_RESUME_PERCENT 80
+/* Scintilla's default position cache size, and the one used for big documents */
+#define POSITION_CACHE_SIZE_DEFAULT 1024
+#define POSITION_CACHE_SIZE_LARGE 4096
+#define POSITION_CACHE_LARGE_DOC_LINES 100000
+
+/* Chooses how much of the line layouts Scintilla keeps cached for @a editor.
+ * The current document caches the layouts of all its lines as long as they fit into the
+ * layout cache budget (which keeps scrolling smooth), otherwise only those of the visible page.
+ * Hidden documents only keep the caret line, so that memory use is bounded by the budget
+ * however many documents are open. */
+void editor_update_layout_cache(GeanyEditor *editor)
+{
+	ScintillaObject *sci;
+	gint current_level;
+	gint level = SC_CACHE_CARET;
+	gint position_cache_size = POSITION_CACHE_SIZE_DEFAULT;
+
+	g_return_if_fail(editor != NULL);
+
+	sci = editor->sci;
+	current_level = (gint) SSM(sci, SCI_GETLAYOUTCACHE, 0, 0);
+	if (editor->document == document_get_current())
+	{
+		const gint lines = sci_get_line_count(sci);
+		guint64 budget = (guint64) MAX(editor_prefs.layout_cache_budget, 0) * 1024 * 1024;
+		const guint64 cost = (guint64) sci_get_length(sci) * LAYOUT_CACHE_BYTES_PER_CHAR +
+			(guint64) lines * LAYOUT_CACHE_BYTES_PER_LINE;
+
+		if (current_level != SC_CACHE_DOCUMENT)
+			budget = budget / 100 * LAYOUT_CACHE_BUDGET_RESUME_PERCENT;
+		level = (cost <= budget) ? SC_CACHE_DOCUMENT : SC_CACHE_PAGE;
+		if (lines >= POSITION_CACHE_LARGE_DOC_LINES)
+			position_cache_size = POSITION_CACHE_SIZE_LARGE;
+	}
+
+	/* changing the level frees the previously cached layouts */
+	if (current_level != level)
+		SSM(sci, SCI_SETLAYOUTCACHE, (uptr_t) level, 0);
+	/* resizing always clears the position cache, so avoid doing it needlessly */
+	if (SSM(sci, SCI_GETPOSITIONCACHE, 0, 0) != position_cache_size)
+		SSM(sci, SCI_SETPOSITIONCACHE, (uptr_t) position_cache_size, 0);
 }
 
 
@@ -139,6 +139,7 @@ typedef struct GeanyEditorPrefs
 	gint		autocompletion_update_freq;
 	gint		scroll_lines_around_cursor;
 	gint		ime_interaction; /* input method editor's candidate window behaviour */
+	gint		layout_cache_budget;	/* hidden pref, in MiB */
 }
 GeanyEditorPrefs;
 
@@ -326,6 +327,8 @@ void editor_set_indentation_guides(GeanyEditor *editor);
 
 void editor_apply_update_prefs(GeanyEditor *editor);
 
+void editor_update_layout_cache(GeanyEditor *editor);
+
 gchar *editor_get_calltip_text(GeanyEditor *editor, const TMTag *tag);
 
 void editor_toggle_fold(GeanyEditor *editor, gint line, gint modifiers);
@@ -42,6 +42,7 @@
 #include "highlighting.h"
 #include "projectprivate.h"
 #include "sciwrappers.h"
+#include "search.h"
 #include "support.h"
 #include "symbols.h"
 #include "tm_parser.h"
@@ -849,6 +850,7 @@ static void filetype_free(gpointer data, G_GNUC_UNUSED gpointer user_data)
 
 	if (ft->priv->error_regex)
 		g_regex_unref(ft->priv->error_regex);
+	g_free(ft->priv->error_regex_literal);
 	g_slist_foreach(ft->priv->tag_files, (GFunc) g_free, NULL);
 	g_slist_free(ft->priv->tag_files);
 
@@ -1273,6 +1275,9 @@ static void compile_regex(GeanyFiletype *ft, gchar *regstr)
 	if (ft->priv->error_regex)
 		g_regex_unref(ft->priv->error_regex);
 	ft->priv->error_regex = regex;
+	/* lines without this can't match, so most build output skips the regex */
+	SETPTR(ft->priv->error_regex_literal,
+		regex ? search_get_regex_required_literal(regstr, FALSE) : NULL);
 }
 
 
@@ -1310,6 +1315,8 @@ gboolean filetypes_parse_error_message(GeanyFiletype *ft, const gchar *message,
 	}
 	if (!ft->priv->error_regex)
 		return FALSE;
+	if (ft->priv->error_regex_literal && !strstr(message, ft->priv->error_regex_literal))
+		return FALSE;
 
 	if (!g_regex_match(ft->priv->error_regex, message, 0, &minfo))
 	{
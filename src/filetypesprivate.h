@@ -53,6 +53,7 @@ typedef struct GeanyFiletypePrivate
 	gint			 project_list_entry;
 	gchar			 *projerror_regex_string;
 	gchar			 *homeerror_regex_string;
+	gchar		*error_regex_literal;	/* text any error_regex match contains, or NULL */
 }
 GeanyFiletypePrivate;
 
@@ -551,6 +551,8 @@ static void init_default_kb(void)
 	add_kb(group, GEANY_KEYS_SEARCH_FINDDOCUMENTUSAGE, NULL,
 		GDK_d, GEANY_PRIMARY_MOD_MASK | GDK_SHIFT_MASK, "popup_finddocumentusage",
 		_("Find Document Usage"), "find_document_usage1");
+	add_kb(group, GEANY_KEYS_SEARCH_FINDWORKSPACEUSAGE, NULL,
+		0, 0, "popup_findworkspaceusage", _("Find Workspace Usage"), "find_workspace_usage1");
 	add_kb(group, GEANY_KEYS_SEARCH_MARKALL, NULL,
 		GDK_m, GEANY_PRIMARY_MOD_MASK | GDK_SHIFT_MASK, "find_markall", _("_Mark All"), "mark_all1");
 
@@ -1562,6 +1564,8 @@ static gboolean cb_func_search_action(guint key_id)
 			on_find_usage1_activate(NULL, NULL); break;
 		case GEANY_KEYS_SEARCH_FINDDOCUMENTUSAGE:
 			on_find_document_usage1_activate(NULL, NULL); break;
+		case GEANY_KEYS_SEARCH_FINDWORKSPACEUSAGE:
+			on_find_workspace_usage1_activate(NULL, NULL); break;
 		case GEANY_KEYS_SEARCH_MARKALL:
 		{
 			gchar *text = NULL;
@@ -1581,9 +1585,9 @@ static gboolean cb_func_search_action(guint key_id)
 			}
 
 			if (sci_has_selection(sci))
-				search_mark_all(doc, text, GEANY_FIND_MATCHCASE);
+				search_mark_all_in_background(doc, text, GEANY_FIND_MATCHCASE);
 			else
-				search_mark_all(doc, text, GEANY_FIND_MATCHCASE | GEANY_FIND_WHOLEWORD);
+				search_mark_all_in_background(doc, text, GEANY_FIND_MATCHCASE | GEANY_FIND_WHOLEWORD);
 
 			g_free(text);
 			break;
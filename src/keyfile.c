@@ -253,12 +253,16 @@ static void init_pref_groups(void)
 		"indent_hard_tab_width", 8);
 	stash_group_add_integer(group, (gint*)&search_prefs.find_selection_type,
 		"find_selection_type", GEANY_FIND_SEL_CURRENT_WORD);
+	stash_group_add_boolean(group, &search_prefs.project_search_index,
+		"project_search_index", FALSE);
 	stash_group_add_string(group, &file_prefs.extract_filetype_regex,
 		"extract_filetype_regex", GEANY_DEFAULT_FILETYPE_REGEX);
 	stash_group_add_boolean(group, &search_prefs.replace_and_find_by_default,
 		"replace_and_find_by_default", TRUE);
 	stash_group_add_integer(group, &editor_prefs.ime_interaction,
 		"editor_ime_interaction", SC_IME_WINDOWED);
+	stash_group_add_integer(group, &editor_prefs.layout_cache_budget,
+		"editor_layout_cache_budget", 64);
 
 	/* Note: Interface-related various prefs are in ui_init_prefs() */
 
@@ -49,6 +49,7 @@
 #include "plugins.h"
 #include "prefs.h"
 #include "printing.h"
+#include "searchindex.h"
 #include "sidebar.h"
 #ifdef HAVE_SOCKET
 # include "socket.h"
@@ -1154,6 +1155,7 @@ gint main_lib(gint argc, gchar **argv)
 
 	msgwin_init();
 	build_init();
+	searchindex_init();
 	ui_create_insert_menu_items();
 	ui_create_insert_date_menu_items();
 	keybindings_init();
@@ -1264,6 +1266,9 @@ static void do_main_quit(void)
 {
 	geany_debug("Quitting...");
 
+	if (app->debug_mode)
+		symbols_log_statistics();
+
 	configuration_save();
 
 	if (app->project != NULL)
@@ -1288,6 +1293,7 @@ static void do_main_quit(void)
 	templates_free_templates();
 	msgwin_finalize();
 	search_finalize();
+	searchindex_finalize();
 	build_finalize();
 	document_finalize();
 	symbols_finalize();
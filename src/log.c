@@ -31,6 +31,7 @@
 
 #include "app.h"
 #include "support.h"
+#include "symbols.h"
 #include "utils.h"
 #include "ui_utils.h"
 
@@ -45,7 +46,8 @@ static GtkTextBuffer *dialog_textbuffer = NULL;
 
 enum
 {
-	DIALOG_RESPONSE_CLEAR = 1
+	DIALOG_RESPONSE_CLEAR = 1,
+	DIALOG_RESPONSE_SYMBOLS
 };
 
 
@@ -171,6 +173,8 @@ static void on_dialog_response(GtkDialog *dialog, gint response, gpointer user_d
 
 		g_string_erase(log_buffer, 0, -1);
 	}
+	else if (response == DIALOG_RESPONSE_SYMBOLS)
+		symbols_log_statistics();
 	else
 	{
 		gtk_widget_destroy(GTK_WIDGET(dialog));
@@ -185,6 +189,7 @@ void log_show_debug_messages_dialog(void)
 
 	dialog = gtk_dialog_new_with_buttons(_("Debug Messages"), GTK_WINDOW(main_widgets.window),
 				GTK_DIALOG_DESTROY_WITH_PARENT,
+				_("_Symbol Statistics"), DIALOG_RESPONSE_SYMBOLS,
 				_("Cl_ear"), DIALOG_RESPONSE_CLEAR,
 				GTK_STOCK_CLOSE, GTK_RESPONSE_CLOSE, NULL);
 	vbox = ui_dialog_vbox_new(GTK_DIALOG(dialog));
@@ -82,6 +82,27 @@ enum
 	COMPILER_COL_COUNT
 };
 
+/* how often queued compiler and message lines are added to their list stores */
+#define MSGWIN_FLUSH_INTERVAL 50
+
+/* a compiler or message line waiting to be added to its list store */
+typedef struct
+{
+	const GdkColor *color;
+	gchar *string;
+	gint line;
+	guint doc_id;
+}
+PendingRow;
+
+static struct
+{
+	GArray *compiler;	/* PendingRow */
+	GArray *msg;		/* PendingRow */
+	guint source_id;
+}
+pending_rows = {NULL, NULL, 0};
+
 
 static void prepare_msg_tree_view(void);
 static void prepare_status_tree_view(void);
@@ -90,6 +111,7 @@ static GtkWidget *create_message_popup_menu(gint type);
 static gboolean on_msgwin_button_press_event(GtkWidget *widget, GdkEventButton *event,
 																			gpointer user_data);
 static void on_scribble_populate(GtkTextView *textview, GtkMenu *arg1, gpointer user_data);
+static void clear_pending_rows(GArray *rows);
 
 
 void msgwin_show_hide_tabs(void)
@@ -130,11 +152,23 @@ void msgwin_init(void)
 
 	ui_widget_modify_font_from_string(msgwindow.scribble, interface_prefs.msgwin_font);
 	g_signal_connect(msgwindow.scribble, "populate-popup", G_CALLBACK(on_scribble_populate), NULL);
+
+	pending_rows.compiler = g_array_new(FALSE, FALSE, sizeof(PendingRow));
+	pending_rows.msg = g_array_new(FALSE, FALSE, sizeof(PendingRow));
 }
 
 
 void msgwin_finalize(void)
 {
+	if (pending_rows.source_id != 0)
+		g_source_remove(pending_rows.source_id);
+	pending_rows.source_id = 0;
+	clear_pending_rows(pending_rows.compiler);
+	clear_pending_rows(pending_rows.msg);
+	g_array_free(pending_rows.compiler, TRUE);
+	g_array_free(pending_rows.msg, TRUE);
+	pending_rows.compiler = pending_rows.msg = NULL;
+
 	g_free(msgwindow.messages_dir);
 }
 
@@ -301,20 +335,36 @@ void msgwin_compiler_add(gint msg_color, const gchar *format, ...)
 }
 
 
-void msgwin_compiler_add_string(gint msg_color, const gchar *msg)
+static void clear_pending_rows(GArray *rows)
 {
+	guint i;
+
+	for (i = 0; i < rows->len; i++)
+		g_free(g_array_index(rows, PendingRow, i).string);
+	g_array_set_size(rows, 0);
+}
+
+
+/* Adds all queued compiler lines to the store at once, then scrolls and updates the
+ * build menu a single time for the whole batch. */
+static void flush_compiler_rows(void)
+{
+	GArray *rows = pending_rows.compiler;
 	GtkTreeIter iter;
-	const GdkColor *color = get_color(msg_color);
-	gchar *utf8_msg;
+	guint i;
 
-	if (! g_utf8_validate(msg, -1, NULL))
-		utf8_msg = utils_get_utf8_from_locale(msg);
-	else
-		utf8_msg = (gchar *) msg;
+	if (rows->len == 0)
+		return;
+
+	for (i = 0; i < rows->len; i++)
+	{
+		PendingRow *row = &g_array_index(rows, PendingRow, i);
 
-	gtk_list_store_append(msgwindow.store_compiler, &iter);
-	gtk_list_store_set(msgwindow.store_compiler, &iter,
-		COMPILER_COL_COLOR, color, COMPILER_COL_STRING, utf8_msg, -1);
+		gtk_list_store_insert_with_values(msgwindow.store_compiler, &iter, -1,
+			COMPILER_COL_COLOR, row->color, COMPILER_COL_STRING, row->string, -1);
+		g_free(row->string);
+	}
+	g_array_set_size(rows, 0);
 
 	if (ui_prefs.msgwindow_visible && interface_prefs.compiler_tab_autoscroll)
 	{
@@ -325,12 +375,84 @@ void msgwin_compiler_add_string(gint msg_color, const gchar *msg)
 		gtk_tree_path_free(path);
 	}
 
-	/* calling build_menu_update for every build message would be overkill, TODO really should call it once when all done */
+	/* calling build_menu_update for every batch would be overkill, the store isn't empty now */
 	gtk_widget_set_sensitive(build_get_menu_items(-1)->menu_item[GBG_FIXED][GBF_NEXT_ERROR], TRUE);
 	gtk_widget_set_sensitive(build_get_menu_items(-1)->menu_item[GBG_FIXED][GBF_PREV_ERROR], TRUE);
+}
+
+
+static void flush_msg_rows(void)
+{
+	GArray *rows = pending_rows.msg;
+	guint i;
+
+	for (i = 0; i < rows->len; i++)
+	{
+		PendingRow *row = &g_array_index(rows, PendingRow, i);
+
+		gtk_list_store_insert_with_values(msgwindow.store_msg, NULL, -1,
+			MSG_COL_LINE, row->line, MSG_COL_DOC_ID, row->doc_id, MSG_COL_COLOR,
+			row->color, MSG_COL_STRING, row->string, -1);
+		g_free(row->string);
+	}
+	g_array_set_size(rows, 0);
+}
+
+
+/* Adds any queued compiler and message lines to their stores, so they can be read back.
+ * Call this before looking at the contents of msgwindow.store_compiler or store_msg. */
+void msgwin_flush(void)
+{
+	if (pending_rows.compiler == NULL)	/* not initialized yet or already finalized */
+		return;
+
+	if (pending_rows.source_id != 0)
+	{
+		g_source_remove(pending_rows.source_id);
+		pending_rows.source_id = 0;
+	}
+	flush_compiler_rows();
+	flush_msg_rows();
+}
+
+
+static gboolean flush_pending_rows_cb(gpointer data)
+{
+	pending_rows.source_id = 0;
+	flush_compiler_rows();
+	flush_msg_rows();
+	return FALSE;
+}
+
 
-	if (utf8_msg != msg)
-		g_free(utf8_msg);
+/* Queues a row, taking ownership of @a string. Build and Find in Files output can
+ * arrive as thousands of lines per second, so rows are added in timed batches rather
+ * than one model update (and redraw) per line. */
+static void queue_row(GArray *rows, const GdkColor *color, gchar *string, gint line, guint doc_id)
+{
+	PendingRow row;
+
+	row.color = color;
+	row.string = string;
+	row.line = line;
+	row.doc_id = doc_id;
+	g_array_append_val(rows, row);
+
+	if (pending_rows.source_id == 0)
+		pending_rows.source_id = g_timeout_add(MSGWIN_FLUSH_INTERVAL, flush_pending_rows_cb, NULL);
+}
+
+
+void msgwin_compiler_add_string(gint msg_color, const gchar *msg)
+{
+	gchar *utf8_msg;
+
+	if (! g_utf8_validate(msg, -1, NULL))
+		utf8_msg = utils_get_utf8_from_locale(msg);
+	else
+		utf8_msg = g_strdup(msg);
+
+	queue_row(pending_rows.compiler, get_color(msg_color), utf8_msg, -1, 0);
 }
 
 
@@ -379,8 +501,6 @@ void msgwin_msg_add(gint msg_color, gint line, GeanyDocument *doc, const gchar *
 /* adds string to the msg treeview */
 void msgwin_msg_add_string(gint msg_color, gint line, GeanyDocument *doc, const gchar *string)
 {
-	GtkTreeIter iter;
-	const GdkColor *color = get_color(msg_color);
 	gchar *tmp;
 	gsize len;
 	gchar *utf8_msg;
@@ -398,18 +518,14 @@ void msgwin_msg_add_string(gint msg_color, gint line, GeanyDocument *doc, const
 		tmp = g_strdup(string);
 
 	if (! g_utf8_validate(tmp, -1, NULL))
+	{
 		utf8_msg = utils_get_utf8_from_locale(tmp);
+		g_free(tmp);
+	}
 	else
 		utf8_msg = tmp;
 
-	gtk_list_store_append(msgwindow.store_msg, &iter);
-	gtk_list_store_set(msgwindow.store_msg, &iter,
-		MSG_COL_LINE, line, MSG_COL_DOC_ID, doc ? doc->id : 0, MSG_COL_COLOR,
-		color, MSG_COL_STRING, utf8_msg, -1);
-
-	g_free(tmp);
-	if (utf8_msg != tmp)
-		g_free(utf8_msg);
+	queue_row(pending_rows.msg, get_color(msg_color), utf8_msg, line, doc ? doc->id : 0);
 }
 
 
@@ -514,6 +630,8 @@ static void on_compiler_treeview_copy_all_activate(GtkMenuItem *menuitem, gpoint
 	gint str_idx = COMPILER_COL_STRING;
 	gboolean valid;
 
+	msgwin_flush();
+
 	switch (GPOINTER_TO_INT(user_data))
 	{
 		case MSG_STATUS:
@@ -780,36 +898,82 @@ static void make_absolute(gchar **filename, const gchar *dir)
 }
 
 
+/* Parses the number at the start of the @a start to @a end range like strtol() would,
+ * but without reading past @a end. Returns FALSE if there is no number. */
+static gboolean parse_line_number(const gchar *start, const gchar *end, gint *line)
+{
+	const gchar *p = start;
+	gboolean negative = FALSE;
+	gint64 value = 0;
+
+	while (p < end && g_ascii_isspace(*p))
+		p++;
+	if (p < end && (*p == '+' || *p == '-'))
+	{
+		negative = (*p == '-');
+		p++;
+	}
+	if (p >= end || ! g_ascii_isdigit(*p))
+		return FALSE;
+
+	for (; p < end && g_ascii_isdigit(*p); p++)
+		value = MIN(value * 10 + (*p - '0'), G_MAXINT);
+
+	*line = negative ? (gint) -value : (gint) value;
+	return TRUE;
+}
+
+
 /* try to parse the file and line number where the error occurred described in line
  * and when something useful is found, it stores the line number in *line and the
  * relevant file with the error in *filename.
  * *line will be -1 if no error was found in string.
- * *filename must be freed unless it is NULL. */
+ * *filename must be freed unless it is NULL.
+ * The fields are found in place like g_strsplit_set() with min_fields tokens would split
+ * them, as this runs for every line of build output. */
 static void parse_file_line(ParseData *data, gchar **filename, gint *line)
 {
-	gchar *end = NULL;
-	gchar **fields;
+	const gchar *field_start, *p;
+	const gchar *line_start = NULL, *line_end = NULL;
+	const gchar *file_start = NULL, *file_end = NULL;
+	guint field = 0;
 
 	*filename = NULL;
 	*line = -1;
 
 	g_return_if_fail(data->string != NULL);
 
-	fields = g_strsplit_set(data->string, data->pattern, data->min_fields);
-
-	/* parse the line */
-	if (g_strv_length(fields) < data->min_fields)
+	/* the last field holds the rest of the string, delimiters included */
+	field_start = data->string;
+	for (p = data->string; field < data->min_fields; p++)
 	{
-		g_strfreev(fields);
-		return;
+		if (*p == '\0' || (field + 1 < data->min_fields && strchr(data->pattern, *p) != NULL))
+		{
+			if (field == data->line_idx)
+			{
+				line_start = field_start;
+				line_end = p;
+			}
+			if ((gint) field == data->file_idx)
+			{
+				file_start = field_start;
+				file_end = p;
+			}
+			field++;
+			if (*p == '\0')
+				break;
+			field_start = p + 1;
+		}
 	}
 
-	*line = strtol(fields[data->line_idx], &end, 10);
+	/* parse the line */
+	if (field < data->min_fields)
+		return;
 
 	/* if the line could not be read, line is 0 and an error occurred, so we leave */
-	if (fields[data->line_idx] == end)
+	if (! parse_line_number(line_start, line_end, line))
 	{
-		g_strfreev(fields);
+		*line = 0;
 		return;
 	}
 
@@ -820,12 +984,10 @@ static void parse_file_line(ParseData *data, gchar **filename, gint *line)
 		GeanyDocument *doc = document_get_current();
 		if (doc != NULL)
 			*filename = g_strdup(doc->file_name);
-		g_strfreev(fields);
 		return;
 	}
 
-	*filename = g_strdup(fields[data->file_idx]);
-	g_strfreev(fields);
+	*filename = g_strndup(file_start, file_end - file_start);
 }
 
 
@@ -1015,7 +1177,6 @@ void msgwin_parse_compiler_error_line(const gchar *string, const gchar *dir,
 		gchar **filename, gint *line)
 {
 	GeanyFiletype *ft;
-	gchar *trimmed_string, *utf8_dir;
 
 	*filename = NULL;
 	*line = -1;
@@ -1023,26 +1184,33 @@ void msgwin_parse_compiler_error_line(const gchar *string, const gchar *dir,
 	if (G_UNLIKELY(string == NULL))
 		return;
 
-	if (dir == NULL)
-		utf8_dir = utils_get_utf8_from_locale(build_info.dir);
-	else
-		utf8_dir = g_strdup(dir);
-	g_return_if_fail(utf8_dir != NULL);
+	g_return_if_fail(dir != NULL || build_info.dir != NULL);
 
-	trimmed_string = g_strdup(string);
-	g_strchug(trimmed_string); /* remove possible leading whitespace */
+	/* skip possible leading whitespace */
+	while (g_ascii_isspace(*string))
+		string++;
 
 	ft = filetypes[build_info.file_type_id];
 
 	/* try parsing with a custom regex */
-	if (!filetypes_parse_error_message(ft, trimmed_string, filename, line))
+	if (!filetypes_parse_error_message(ft, string, filename, line))
 	{
 		/* fallback to default old-style parsing */
-		parse_compiler_error_line(trimmed_string, filename, line);
+		parse_compiler_error_line(string, filename, line);
+	}
+
+	/* most lines aren't errors, so only convert the directory when it's needed */
+	if (*filename != NULL && ! utils_is_absolute_path(*filename))
+	{
+		gchar *utf8_dir;
+
+		if (dir == NULL)
+			utf8_dir = utils_get_utf8_from_locale(build_info.dir);
+		else
+			utf8_dir = g_strdup(dir);
+		make_absolute(filename, utf8_dir);
+		g_free(utf8_dir);
 	}
-	make_absolute(filename, utf8_dir);
-	g_free(trimmed_string);
-	g_free(utf8_dir);
 }
 
 
@@ -1255,10 +1423,12 @@ void msgwin_clear_tab(gint tabnum)
 	switch (tabnum)
 	{
 		case MSG_MESSAGE:
+			clear_pending_rows(pending_rows.msg);
 			store = msgwindow.store_msg;
 			break;
 
 		case MSG_COMPILER:
+			clear_pending_rows(pending_rows.compiler);
 			gtk_list_store_clear(msgwindow.store_compiler);
 			build_menu_update(NULL);	/* update next error items */
 			return;
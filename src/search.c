@@ -34,10 +34,13 @@
 #include "document.h"
 #include "encodings.h"
 #include "encodingsprivate.h"
+#include "filetypes.h"
+#include "highlighting.h"
 #include "keyfile.h"
 #include "msgwindow.h"
 #include "prefs.h"
 #include "sciwrappers.h"
+#include "searchindex.h"
 #include "spawn.h"
 #include "stash.h"
 #include "support.h"
@@ -53,6 +56,14 @@
 
 #include <gdk/gdkkeysyms.h>
 
+/* Find in Files only passes the files the project index found to grep if they fit
+ * in this many bytes of command line, otherwise it searches the whole directory. */
+#ifdef G_OS_WIN32
+#define FIF_MAX_INDEXED_ARGS_LEN (16 * 1024)
+#else
+#define FIF_MAX_INDEXED_ARGS_LEN (128 * 1024)
+#endif
+
 enum
 {
 	GEANY_RESPONSE_FIND = 1,
@@ -155,8 +166,18 @@ static void search_finished(GPid child_pid, gint status, gpointer user_data);
 
 static gchar **search_get_argv(const gchar **argv_prefix, const gchar *dir);
 
+static gchar **search_get_indexed_argv(const gchar *search_text, const gchar *dir, const gchar *enc);
+
 static GRegex *compile_regex(const gchar *str, GeanyFindFlags sflags);
 
+static gint find_text_regex(ScintillaObject *sci, GRegex *regex, GeanyFindFlags flags,
+		struct Sci_TextToFind *ttf, GeanyMatchInfo **match_, gboolean copy_text);
+
+static gint find_regex(ScintillaObject *sci, guint pos, GRegex *regex, gboolean multiline,
+		GeanyMatchInfo *match, gboolean copy_text);
+
+static gint geany_find_flags_to_sci_flags(GeanyFindFlags flags);
+
 
 static void
 on_find_replace_checkbutton_toggled(GtkToggleButton *togglebutton, gpointer user_data);
@@ -186,6 +207,12 @@ static gboolean
 search_find_in_files(const gchar *utf8_search_text, const gchar *dir, const gchar *opts,
 	const gchar *enc);
 
+static void workspace_usage_cancel(void);
+
+static void workspace_usage_finalize(void);
+
+static void show_usage_count(gint count, const gchar *original_search_text);
+
 
 static void init_prefs(void)
 {
@@ -291,6 +318,7 @@ void search_finalize(void)
 	FREE_WIDGET(fif_dlg.dialog);
 	g_free(search_data.text);
 	g_free(search_data.original_text);
+	workspace_usage_finalize();
 }
 
 
@@ -1196,12 +1224,23 @@ static GSList *find_range(ScintillaObject *sci, GeanyFindFlags flags, struct Sci
 {
 	GSList *matches = NULL;
 	GeanyMatchInfo *info;
+	GRegex *regex = NULL;
 
 	g_return_val_if_fail(sci != NULL && ttf->lpstrText != NULL, NULL);
 	if (! *ttf->lpstrText)
 		return NULL;
 
-	while (search_find_text(sci, flags, ttf, &info) != -1)
+	/* compile the regex only once for all matches */
+	if (flags & GEANY_FIND_REGEXP)
+	{
+		regex = compile_regex(ttf->lpstrText, flags);
+		if (!regex)
+			return NULL;
+	}
+
+	/* the match texts aren't copied, search_replace_range() reads them from the document */
+	while ((regex ? find_text_regex(sci, regex, flags, ttf, &info, FALSE) :
+			search_find_text(sci, flags, ttf, &info)) != -1)
 	{
 		if (ttf->chrgText.cpMax > ttf->chrg.cpMax)
 		{
@@ -1220,44 +1259,275 @@ static GSList *find_range(ScintillaObject *sci, GeanyFindFlags flags, struct Sci
 			ttf->chrg.cpMin ++;
 	}
 
+	if (regex)
+		g_regex_unref(regex);
+
 	return g_slist_reverse(matches);
 }
 
 
+/* A search to mark all matches of, see mark_matches() */
+typedef struct MarkAllSearch
+{
+	gchar *text;
+	GeanyFindFlags flags;
+	GRegex *regex;	/* compiled text for regex searches */
+	GeanyMatchInfo *match;	/* reused for regex matches */
+}
+MarkAllSearch;
+
+
+/* Mark all search continuing in the background, see search_mark_all_in_background() */
+static struct
+{
+	GeanyDocument *doc;
+	guint doc_id;
+	MarkAllSearch *search;
+	gint pos;	/* where to continue marking */
+	gint limit;	/* start of the part marked at once, where marking stops after wrapping */
+	gboolean wrapped;	/* whether marking continues from the document start */
+	guint source_id;
+}
+mark_all_job = {NULL, 0, NULL, 0, 0, FALSE, 0};
+
+
+static MarkAllSearch *mark_all_search_new(const gchar *text, GeanyFindFlags flags)
+{
+	MarkAllSearch *search = g_new0(MarkAllSearch, 1);
+
+	if (flags & GEANY_FIND_REGEXP)
+	{
+		search->regex = compile_regex(text, flags);
+		if (! search->regex)
+		{
+			g_free(search);
+			return NULL;
+		}
+		search->match = match_info_new(flags, 0, 0);
+	}
+	search->text = g_strdup(text);
+	search->flags = flags;
+	return search;
+}
+
+
+static void mark_all_search_free(MarkAllSearch *search)
+{
+	if (search->regex)
+		g_regex_unref(search->regex);
+	if (search->match)
+		geany_match_info_free(search->match);
+	g_free(search->text);
+	g_free(search);
+}
+
+
+/* Marks the matches of @a search which start at or after @a pos and before @a limit.
+ * Matches are not copied, and adjacent or overlapping ones are coalesced into a single
+ * indicator fill.
+ * @a count is increased by the number of matches found.
+ * Returns: the position to continue searching from, or -1 if there are no more matches. */
+static gint mark_matches(ScintillaObject *sci, MarkAllSearch *search, gint pos, gint limit, gint *count)
+{
+	const gint length = sci_get_length(sci);
+	gint run_start = -1, run_end = -1;
+
+	sci_indicator_set(sci, GEANY_INDICATOR_SEARCH);
+	while (pos <= length)
+	{
+		gint start, end;
+
+		if (search->regex)
+		{
+			start = find_regex(sci, pos, search->regex, search->flags & GEANY_FIND_MULTILINE,
+				search->match, FALSE);
+			end = search->match->end;
+		}
+		else
+		{
+			struct Sci_TextToFind ttf;
+
+			ttf.chrg.cpMin = pos;
+			ttf.chrg.cpMax = length;
+			ttf.lpstrText = search->text;
+			start = sci_find_text(sci, geany_find_flags_to_sci_flags(search->flags), &ttf);
+			end = ttf.chrgText.cpMax;
+		}
+		if (start < 0 || start >= limit)
+		{
+			pos = start;
+			break;
+		}
+		(*count)++;
+
+		if (start > run_end)
+		{
+			if (run_end > run_start)
+				sci_indicator_fill(sci, run_start, run_end - run_start);
+			run_start = start;
+		}
+		run_end = MAX(run_end, end);
+
+		/* avoid rematching with empty matches */
+		pos = (end == start) ? end + 1 : end;
+	}
+	if (run_end > run_start)
+		sci_indicator_fill(sci, run_start, run_end - run_start);
+
+	return (pos > length) ? -1 : pos;
+}
+
+
+static void mark_all_job_cancel(void)
+{
+	if (mark_all_job.source_id != 0)
+	{
+		g_source_remove(mark_all_job.source_id);
+		mark_all_job.source_id = 0;
+	}
+	if (mark_all_job.search)
+	{
+		mark_all_search_free(mark_all_job.search);
+		mark_all_job.search = NULL;
+	}
+	mark_all_job.doc = NULL;
+}
+
+
+static gint shift_position(gint pos, gint edit_pos, gint length, gboolean inserted)
+{
+	if (inserted)
+		return (edit_pos < pos) ? pos + length : pos;
+	if (edit_pos + length <= pos)
+		return pos - length;
+	return MIN(pos, edit_pos);
+}
+
+
+/* Keeps the position of the background mark all in sync with an insertion or deletion in
+ * @a doc, so that it goes on marking the same text. */
+void search_mark_all_text_changed(GeanyDocument *doc, gint position, gint length, gboolean inserted)
+{
+	if (mark_all_job.doc != doc)
+		return;
+
+	mark_all_job.pos = shift_position(mark_all_job.pos, position, length, inserted);
+	mark_all_job.limit = shift_position(mark_all_job.limit, position, length, inserted);
+}
+
+
+/* Amount of text to mark in each idle call of a background mark all */
+#define MARK_ALL_CHUNK_SIZE (256 * 1024)
+
+static gboolean mark_all_in_idle(gpointer data)
+{
+	GeanyDocument *doc = mark_all_job.doc;
+	ScintillaObject *sci;
+	gint count = 0;
+	gint end, pos;
+
+	if (! DOC_VALID(doc) || doc->id != mark_all_job.doc_id)
+	{
+		mark_all_job.source_id = 0;
+		mark_all_job_cancel();
+		return FALSE;
+	}
+
+	sci = doc->editor->sci;
+	end = mark_all_job.wrapped ? mark_all_job.limit : sci_get_length(sci) + 1;
+	pos = mark_matches(sci, mark_all_job.search, mark_all_job.pos,
+		MIN(mark_all_job.pos + MARK_ALL_CHUNK_SIZE, end), &count);
+	if (pos >= 0 && pos < end)
+		mark_all_job.pos = pos;
+	else if (! mark_all_job.wrapped && mark_all_job.limit > 0)
+	{
+		/* reached the document end, go on from its start */
+		mark_all_job.wrapped = TRUE;
+		mark_all_job.pos = 0;
+	}
+	else
+	{
+		mark_all_job.source_id = 0;
+		mark_all_job_cancel();
+		return FALSE;
+	}
+	return TRUE;
+}
+
+
 /* Clears markers if text is null/empty.
  * @return Number of matches marked. */
 gint search_mark_all(GeanyDocument *doc, const gchar *search_text, GeanyFindFlags flags)
 {
+	MarkAllSearch *search;
 	gint count = 0;
-	struct Sci_TextToFind ttf;
-	GSList *match, *matches;
 
 	g_return_val_if_fail(DOC_VALID(doc), 0);
 
+	mark_all_job_cancel();
+
 	/* clear previous search indicators */
 	editor_indicator_clear(doc->editor, GEANY_INDICATOR_SEARCH);
 
 	if (G_UNLIKELY(EMPTY(search_text)))
 		return 0;
 
-	ttf.chrg.cpMin = 0;
-	ttf.chrg.cpMax = sci_get_length(doc->editor->sci);
-	ttf.lpstrText = (gchar *)search_text;
+	search = mark_all_search_new(search_text, flags);
+	if (! search)
+		return 0;
 
-	matches = find_range(doc->editor->sci, flags, &ttf);
-	foreach_slist (match, matches)
-	{
-		GeanyMatchInfo *info = match->data;
+	mark_matches(doc->editor->sci, search, 0, sci_get_length(doc->editor->sci) + 1, &count);
+	mark_all_search_free(search);
 
-		if (info->end != info->start)
-			editor_indicator_set_on_range(doc->editor, GEANY_INDICATOR_SEARCH, info->start, info->end);
-		count++;
+	return count;
+}
 
-		geany_match_info_free(info);
-	}
-	g_slist_free(matches);
 
-	return count;
+/* Like search_mark_all(), but only marks the visible part of the document at once,
+ * the rest is marked in the background without blocking the UI for long documents. */
+void search_mark_all_in_background(GeanyDocument *doc, const gchar *search_text, GeanyFindFlags flags)
+{
+	ScintillaObject *sci;
+	MarkAllSearch *search;
+	gint first_line, last_line, vis_start, vis_end;
+	gint count = 0;
+
+	g_return_if_fail(DOC_VALID(doc));
+
+	mark_all_job_cancel();
+	editor_indicator_clear(doc->editor, GEANY_INDICATOR_SEARCH);
+
+	if (EMPTY(search_text))
+		return;
+
+	search = mark_all_search_new(search_text, flags);
+	if (! search)
+		return;
+
+	sci = doc->editor->sci;
+	first_line = SSM(sci, SCI_DOCLINEFROMVISIBLE, sci_get_first_visible_line(sci), 0);
+	last_line = SSM(sci, SCI_DOCLINEFROMVISIBLE,
+		sci_get_first_visible_line(sci) + SSM(sci, SCI_LINESONSCREEN, 0, 0), 0);
+	vis_start = sci_get_position_from_line(sci, first_line);
+	vis_end = sci_get_line_end_position(sci, last_line);
+
+	mark_all_job.pos = mark_matches(sci, search, vis_start, vis_end + 1, &count);
+	mark_all_job.wrapped = (mark_all_job.pos < 0);
+	if (mark_all_job.wrapped)
+	{
+		if (vis_start == 0)
+		{
+			/* the whole document is visible */
+			mark_all_search_free(search);
+			return;
+		}
+		mark_all_job.pos = 0;
+	}
+	mark_all_job.doc = doc;
+	mark_all_job.doc_id = doc->id;
+	mark_all_job.search = search;
+	mark_all_job.limit = vis_start;
+	mark_all_job.source_id = g_idle_add(mark_all_in_idle, NULL);
 }
 
 
@@ -1670,32 +1940,55 @@ search_find_in_files(const gchar *utf8_search_text, const gchar *utf8_dir, const
 	if (search_text == NULL)
 		search_text = g_strdup(utf8_search_text);
 
-	argv_prefix = g_new(gchar*, 3);
-	argv_prefix[0] = search_text;
 	dir = utils_get_locale_from_utf8(utf8_dir);
+	argv = settings.fif_recursive ? search_get_indexed_argv(search_text, dir, enc) : NULL;
+	if (argv != NULL && argv[1] == NULL)
+	{
+		/* the project index tells no file can match */
+		workspace_usage_cancel();
+		msgwin_clear_tab(MSG_MESSAGE);
+		gtk_notebook_set_current_page(GTK_NOTEBOOK(msgwindow.notebook), MSG_MESSAGE);
+		msgwin_set_messages_dir(dir);
+		msgwin_msg_add(COLOR_BLUE, -1, NULL, _("%s %s -- %s (in directory: %s)"),
+			tool_prefs.grep_cmd, opts, utf8_search_text, utf8_dir);
+		msgwin_msg_add_string(COLOR_BLUE, -1, NULL, _("No matches found."));
+		ui_set_statusbar(FALSE, "%s", _("No matches found."));
+		utils_free_pointers(3, dir, command_line, search_text, NULL);
+		g_strfreev(argv);
+		return TRUE;
+	}
 
 	/* finally add the arguments(files to be searched) */
-	if (settings.fif_recursive)	/* recursive option set */
-	{
-		/* Use '.' so we get relative paths in the output */
-		argv_prefix[1] = g_strdup(".");
-		argv_prefix[2] = NULL;
-		argv = argv_prefix;
-	}
+	if (argv != NULL)	/* only the files the project index found */
+		g_free(search_text);
 	else
 	{
-		argv_prefix[1] = NULL;
-		argv = search_get_argv((const gchar**)argv_prefix, dir);
-		g_strfreev(argv_prefix);
+		argv_prefix = g_new(gchar*, 3);
+		argv_prefix[0] = search_text;
 
-		if (argv == NULL)	/* no files */
+		if (settings.fif_recursive)	/* recursive option set */
 		{
-			g_free(command_line);
-			return FALSE;
+			/* Use '.' so we get relative paths in the output */
+			argv_prefix[1] = g_strdup(".");
+			argv_prefix[2] = NULL;
+			argv = argv_prefix;
+		}
+		else
+		{
+			argv_prefix[1] = NULL;
+			argv = search_get_argv((const gchar**)argv_prefix, dir);
+			g_strfreev(argv_prefix);
+
+			if (argv == NULL)	/* no files */
+			{
+				g_free(command_line);
+				return FALSE;
+			}
 		}
 	}
 
-	gtk_list_store_clear(msgwindow.store_msg);
+	workspace_usage_cancel();
+	msgwin_clear_tab(MSG_MESSAGE);
 	gtk_notebook_set_current_page(GTK_NOTEBOOK(msgwindow.notebook), MSG_MESSAGE);
 
 	/* we can pass 'enc' without strdup'ing it here because it's a global const string and
@@ -1804,6 +2097,84 @@ static gchar **search_get_argv(const gchar **argv_prefix, const gchar *dir)
 }
 
 
+/* Creates an argument vector of the search text followed by the files in dir which the
+ * project index found may match it, with paths relative to dir.
+ * Returns NULL if the index can't narrow down the files to search, otherwise returned vector
+ * should be fully freed. */
+static gchar **search_get_indexed_argv(const gchar *search_text, const gchar *dir, const gchar *enc)
+{
+	const gboolean caseless = ! settings.fif_case_sensitive;
+	GSList *patterns = NULL, *item;
+	GPtrArray *files, *args;
+	gchar *literal;
+	gsize args_len = 0;
+	guint i;
+
+	/* the index only knows about the file contents as they are */
+	if (enc != NULL || settings.fif_invert_results || strchr(search_text, '\n') != NULL ||
+		(settings.fif_use_extra_options && ! EMPTY(settings.fif_extra_options)))
+		return NULL;
+
+	if (settings.fif_regexp)
+		literal = search_get_regex_required_literal(search_text, caseless);
+	else
+		literal = g_strdup(search_text);
+	if (literal == NULL)
+		return NULL;
+
+	files = searchindex_find_files(dir, literal, caseless);
+	g_free(literal);
+	if (files == NULL)
+		return NULL;
+
+	if (settings.fif_files_mode != FILES_MODE_ALL && ! EMPTY(settings.fif_files))
+	{
+		gchar **names = g_strsplit(settings.fif_files, " ", -1);
+		gchar **name;
+
+		foreach_strv(name, names)
+		{
+			if (**name)
+				patterns = g_slist_prepend(patterns, g_pattern_spec_new(*name));
+		}
+		g_strfreev(names);
+	}
+
+	args = g_ptr_array_new();
+	g_ptr_array_add(args, g_strdup(search_text));
+	for (i = 0; i < files->len && args_len <= FIF_MAX_INDEXED_ARGS_LEN; i++)
+	{
+		const gchar *path = g_ptr_array_index(files, i);
+		gchar *name = g_path_get_basename(path);
+
+		/* like --include= */
+		if (patterns == NULL || pattern_list_match(patterns, name))
+		{
+			/* use "./" like when searching "." so we get the same output */
+			gchar *arg = g_build_filename(".", path, NULL);
+
+			args_len += strlen(arg) + 1;
+			g_ptr_array_add(args, arg);
+		}
+		g_free(name);
+	}
+	g_ptr_array_add(args, NULL);
+
+	foreach_slist(item, patterns)
+		g_pattern_spec_free(item->data);
+	g_slist_free(patterns);
+	g_ptr_array_free(files, TRUE);
+
+	if (args_len > FIF_MAX_INDEXED_ARGS_LEN)
+	{
+		/* too many files, searching the directory is simpler */
+		g_strfreev((gchar **) g_ptr_array_free(args, FALSE));
+		return NULL;
+	}
+	return (gchar **) g_ptr_array_free(args, FALSE);
+}
+
+
 static void read_fif_io(gchar *msg, GIOCondition condition, gchar *enc, gint msg_color)
 {
 	if (condition & (G_IO_IN | G_IO_PRI))
@@ -1867,9 +2238,13 @@ static void search_finished(GPid child_pid, gint status, gpointer user_data)
 	{
 		case 0:
 		{
-			gint count = gtk_tree_model_iter_n_children(
+			gint count;
+			gchar *text;
+
+			msgwin_flush();
+			count = gtk_tree_model_iter_n_children(
 				GTK_TREE_MODEL(msgwindow.store_msg), NULL) - 1;
-			gchar *text = ngettext(
+			text = ngettext(
 						"Search completed with %d match.",
 						"Search completed with %d matches.", count);
 
@@ -1914,19 +2289,178 @@ static GRegex *compile_regex(const gchar *str, GeanyFindFlags sflags)
 }
 
 
-/* groups that don't exist are handled OK as len = end - start = (-1) - (-1) = 0 */
-static gchar *get_regex_match_string(const gchar *text, const GeanyMatchInfo *match, guint nth)
+/* Appends the replacement for @a match to @a str, expanding group references like \1
+ * for regex matches from @a match_text, the text of the whole match.
+ * Groups that don't exist are handled OK as len = end - start = (-1) - (-1) = 0 */
+static void append_replacement(GString *str, const GeanyMatchInfo *match, const gchar *match_text,
+		const gchar *replace_text)
 {
-	const gint start = match->matches[nth].start;
-	const gint end = match->matches[nth].end;
-	return g_strndup(&text[start], end - start);
+	const gchar *ptr;
+
+	if (! (match->flags & GEANY_FIND_REGEXP))
+	{
+		g_string_append(str, replace_text);
+		return;
+	}
+
+	for (ptr = replace_text; *ptr; ptr++)
+	{
+		if (ptr[0] != '\\')
+			g_string_append_c(str, ptr[0]);
+		else if (isdigit(ptr[1]))
+		{
+			/* digit escape */
+			const guint nth = ptr[1] - '0';
+			const gint start = match->matches[nth].start;
+
+			/* fix match offsets by subtracting index of whole match start from the string */
+			g_string_append_len(str, match_text + start - match->matches[0].start,
+				match->matches[nth].end - start);
+			ptr++;
+		}
+		else if (ptr[1])
+		{
+			/* backslash or unnecessary escape */
+			g_string_append_c(str, ptr[1]);
+			ptr++;
+		}
+	}
 }
 
 
-static gint find_regex(ScintillaObject *sci, guint pos, GRegex *regex, gboolean multiline, GeanyMatchInfo *match)
+/* Ends the current literal run, keeping it if it is the longest one so far */
+static void end_literal_run(GString *run, GString *best)
+{
+	if (run->len > best->len)
+		g_string_assign(best, run->str);
+	g_string_truncate(run, 0);
+}
+
+
+/* Extracts a literal string which any match of @a pattern must contain, so lines without it
+ * can be skipped without running the regex on them. This is conservative: only plain ASCII
+ * characters outside of groups and character classes are considered, and it gives up on
+ * alternations, inline options and escapes which could change how the rest is read.
+ * When @a caseless, letters which also match non-ASCII characters (like K and the Kelvin
+ * sign) are not considered either.
+ * Returns: the longest such literal, or NULL if there is none. */
+gchar *search_get_regex_required_literal(const gchar *pattern, gboolean caseless)
+{
+	GString *run = g_string_new(NULL);
+	GString *best = g_string_new(NULL);
+	gboolean give_up = FALSE;
+	gint depth = 0;
+	const gchar *p;
+
+	for (p = pattern; *p; p++)
+	{
+		const gchar c = *p;
+
+		if (c == '|' ||
+			(c == '(' && p[1] == '?' && (g_ascii_isalpha(p[2]) || p[2] == '-' || p[2] == '^')) ||
+			(c == '\\' && strchr("xpPcgkNoQE0123456789", p[1]) != NULL))
+		{
+			/* alternation, inline option or escape taking an argument */
+			give_up = TRUE;
+			break;
+		}
+		else if (c == '\\')
+		{
+			end_literal_run(run, best);
+			p++;
+		}
+		else if (c == '[')
+		{
+			end_literal_run(run, best);
+			p++;
+			if (*p == '^')
+				p++;
+			if (*p == ']')
+				p++;
+			for (; *p && *p != ']'; p++)
+			{
+				if (*p == '\\' && p[1])
+					p++;
+				else if (*p == '[' && p[1] == ':')
+				{
+					const gchar *class_end = strstr(p, ":]");
+
+					if (class_end)
+						p = class_end + 1;
+				}
+			}
+			if (! *p)
+			{
+				give_up = TRUE;
+				break;
+			}
+		}
+		else if (c == '?' || c == '*' || c == '{')
+		{
+			/* the quantified character is optional */
+			if (run->len > 0)
+				g_string_truncate(run, run->len - 1);
+			end_literal_run(run, best);
+			if (c == '{' && strchr(p, '}') != NULL)
+				p = strchr(p, '}');
+		}
+		else if (c == '(')
+		{
+			end_literal_run(run, best);
+			depth++;
+		}
+		else if (c == ')')
+		{
+			end_literal_run(run, best);
+			depth--;
+		}
+		else if (depth > 0 || strchr("+^$.]}", c) != NULL || ! g_ascii_isprint(c) ||
+			(caseless && strchr("kKsS", c) != NULL))
+			end_literal_run(run, best);
+		else
+			g_string_append_c(run, c);
+	}
+	end_literal_run(run, best);
+	g_string_free(run, TRUE);
+
+	return g_string_free(best, give_up || best->len == 0);
+}
+
+
+/* Finds @a literal in the @a len bytes at @a text, ignoring ASCII case if @a caseless. */
+static const gchar *find_literal(const gchar *text, gsize len, const gchar *literal, gboolean caseless)
+{
+	const gsize literal_len = strlen(literal);
+	const gchar *p;
+
+	if (literal_len > len)
+		return NULL;
+
+	if (! caseless)
+	{
+		for (p = text; (p = memchr(p, literal[0], len - literal_len + 1 - (p - text))) != NULL; p++)
+		{
+			if (memcmp(p, literal, literal_len) == 0)
+				return p;
+		}
+		return NULL;
+	}
+	for (p = text; p <= text + len - literal_len; p++)
+	{
+		if (g_ascii_strncasecmp(p, literal, literal_len) == 0)
+			return p;
+	}
+	return NULL;
+}
+
+
+/* copy_text is whether to copy the matched text to match->match_text, which is needed
+ * by search_replace_match() */
+static gint find_regex(ScintillaObject *sci, guint pos, GRegex *regex, gboolean multiline,
+		GeanyMatchInfo *match, gboolean copy_text)
 {
 	const gchar *text;
-	GMatchInfo *minfo;
+	GMatchInfo *minfo = NULL;
 	guint document_length;
 	gint ret = -1;
 	gint offset = 0;
@@ -1937,46 +2471,69 @@ static gint find_regex(ScintillaObject *sci, guint pos, GRegex *regex, gboolean
 
 	g_return_val_if_fail(pos <= document_length, -1);
 
+	/* Warning: any SCI calls modifying the document will invalidate 'text'
+	 * after calling SCI_GETCHARACTERPOINTER */
+	text = (void*)SSM(sci, SCI_GETCHARACTERPOINTER, 0, 0);
+
 	if (multiline)
 	{
-		/* Warning: any SCI calls will invalidate 'text' after calling SCI_GETCHARACTERPOINTER */
-		text = (void*)SSM(sci, SCI_GETCHARACTERPOINTER, 0, 0);
 		g_regex_match_full(regex, text, -1, pos, 0, &minfo, NULL);
 	}
 	else /* single-line mode, manually match against each line */
 	{
 		gint line = sci_get_line_from_position(sci, pos);
+		const gboolean caseless = (g_regex_get_compile_flags(regex) & G_REGEX_CASELESS) != 0;
+		gchar *literal = search_get_regex_required_literal(g_regex_get_pattern(regex), caseless);
 
 		for (;;)
 		{
-			gint start = sci_get_position_from_line(sci, line);
-			gint end = sci_get_line_end_position(sci, line);
+			gint start, end;
+
+			if (literal)
+			{
+				/* skip to the next line containing the literal all matches need */
+				const gchar *found = find_literal(text + pos, document_length - pos, literal, caseless);
+				gint found_line;
+
+				if (! found)
+					break;
+				found_line = sci_get_line_from_position(sci, found - text);
+				if (found_line != line)
+				{
+					line = found_line;
+					pos = sci_get_position_from_line(sci, line);
+				}
+			}
 
-			text = (void*)SSM(sci, SCI_GETRANGEPOINTER, start, end - start);
-			if (g_regex_match_full(regex, text, end - start, pos - start, 0, &minfo, NULL))
+			start = sci_get_position_from_line(sci, line);
+			end = sci_get_line_end_position(sci, line);
+
+			if (g_regex_match_full(regex, text + start, end - start, pos - start, 0, &minfo, NULL))
 			{
 				offset = start;
 				break;
 			}
 			else /* not found, try next line */
 			{
+				g_match_info_free(minfo);
+				minfo = NULL;
 				line ++;
 				if (line >= sci_get_line_count(sci))
 					break;
 				pos = sci_get_position_from_line(sci, line);
-				/* don't free last info, it's freed below */
-				g_match_info_free(minfo);
 			}
 		}
+		g_free(literal);
 	}
 
 	/* Warning: minfo will become invalid when 'text' does! */
-	if (g_match_info_matches(minfo))
+	if (minfo != NULL && g_match_info_matches(minfo))
 	{
 		guint i;
 
 		/* copy whole match text and offsets before they become invalid */
-		SETPTR(match->match_text, g_match_info_fetch(minfo, 0));
+		if (copy_text)
+			SETPTR(match->match_text, g_match_info_fetch(minfo, 0));
 
 		foreach_range(i, G_N_ELEMENTS(match->matches))
 		{
@@ -2041,10 +2598,10 @@ gint search_find_next(ScintillaObject *sci, const gchar *str, GeanyFindFlags fla
 	match = match_info_new(flags, 0, 0);
 
 	pos = sci_get_current_position(sci);
-	ret = find_regex(sci, pos, regex, flags & GEANY_FIND_MULTILINE, match);
+	ret = find_regex(sci, pos, regex, flags & GEANY_FIND_MULTILINE, match, TRUE);
 	/* avoid re-matching the same position in case of empty matches */
 	if (ret == pos && match->matches[0].start == match->matches[0].end)
-		ret = find_regex(sci, pos + 1, regex, flags & GEANY_FIND_MULTILINE, match);
+		ret = find_regex(sci, pos + 1, regex, flags & GEANY_FIND_MULTILINE, match, TRUE);
 	if (ret >= 0)
 		sci_set_selection(sci, match->start, match->end);
 
@@ -2058,55 +2615,63 @@ gint search_find_next(ScintillaObject *sci, const gchar *str, GeanyFindFlags fla
 }
 
 
-gint search_replace_match(ScintillaObject *sci, const GeanyMatchInfo *match, const gchar *replace_text)
+static gint replace_match(ScintillaObject *sci, const GeanyMatchInfo *match, const gchar *match_text,
+		const gchar *replace_text)
 {
 	GString *str;
-	gint ret = 0;
-	gint i = 0;
+	gint ret;
 
+	if (! (match->flags & GEANY_FIND_REGEXP))
+	{
+		sci_set_target_start(sci, match->start);
+		sci_set_target_end(sci, match->end);
+		return sci_replace_target(sci, replace_text, FALSE);
+	}
+
+	/* build the replacement before changing the target, match_text may be a range pointer */
+	str = g_string_new(NULL);
+	append_replacement(str, match, match_text, replace_text);
 	sci_set_target_start(sci, match->start);
 	sci_set_target_end(sci, match->end);
+	ret = sci_replace_target(sci, str->str, FALSE);
+	g_string_free(str, TRUE);
+	return ret;
+}
 
-	if (! (match->flags & GEANY_FIND_REGEXP))
-		return sci_replace_target(sci, replace_text, FALSE);
 
-	str = g_string_new(replace_text);
-	while (str->str[i])
-	{
-		gchar *ptr = &str->str[i];
-		gchar *grp;
-		gchar c;
+gint search_replace_match(ScintillaObject *sci, const GeanyMatchInfo *match, const gchar *replace_text)
+{
+	return replace_match(sci, match, match->match_text, replace_text);
+}
 
-		if (ptr[0] != '\\')
-		{
-			i++;
-			continue;
-		}
-		c = ptr[1];
-		/* backslash or unnecessary escape */
-		if (c == '\\' || !isdigit(c))
-		{
-			g_string_erase(str, i, 1);
-			i++;
-			continue;
-		}
-		/* digit escape */
-		g_string_erase(str, i, 2);
-		/* fix match offsets by subtracting index of whole match start from the string */
-		grp = get_regex_match_string(match->match_text - match->matches[0].start, match, c - '0');
-		g_string_insert(str, i, grp);
-		i += strlen(grp);
-		g_free(grp);
+
+/* copy_text is whether to copy the matched text to match->match_text, see find_regex() */
+static gint find_text_regex(ScintillaObject *sci, GRegex *regex, GeanyFindFlags flags,
+		struct Sci_TextToFind *ttf, GeanyMatchInfo **match_, gboolean copy_text)
+{
+	GeanyMatchInfo *match = match_info_new(flags, 0, 0);
+	gint ret;
+
+	ret = find_regex(sci, ttf->chrg.cpMin, regex, flags & GEANY_FIND_MULTILINE, match, copy_text);
+	if (ret >= ttf->chrg.cpMax)
+		ret = -1;
+	else if (ret >= 0)
+	{
+		ttf->chrgText.cpMin = match->start;
+		ttf->chrgText.cpMax = match->end;
 	}
-	ret = sci_replace_target(sci, str->str, FALSE);
-	g_string_free(str, TRUE);
+
+	if (ret != -1 && match_)
+		*match_ = match;
+	else
+		geany_match_info_free(match);
+
 	return ret;
 }
 
 
 gint search_find_text(ScintillaObject *sci, GeanyFindFlags flags, struct Sci_TextToFind *ttf, GeanyMatchInfo **match_)
 {
-	GeanyMatchInfo *match = NULL;
 	GRegex *regex;
 	gint ret;
 
@@ -2122,33 +2687,22 @@ gint search_find_text(ScintillaObject *sci, GeanyFindFlags flags, struct Sci_Tex
 	if (!regex)
 		return -1;
 
-	match = match_info_new(flags, 0, 0);
-
-	ret = find_regex(sci, ttf->chrg.cpMin, regex, flags & GEANY_FIND_MULTILINE, match);
-	if (ret >= ttf->chrg.cpMax)
-		ret = -1;
-	else if (ret >= 0)
-	{
-		ttf->chrgText.cpMin = match->start;
-		ttf->chrgText.cpMax = match->end;
-	}
-
-	if (ret != -1 && match_)
-		*match_ = match;
-	else
-		geany_match_info_free(match);
+	ret = find_text_regex(sci, regex, flags, ttf, match_, TRUE);
 
 	g_regex_unref(regex);
 	return ret;
 }
 
 
-static gint find_document_usage(GeanyDocument *doc, const gchar *search_text, GeanyFindFlags flags)
+/* @a code_only skips matches inside comments and strings. */
+static gint find_document_usage(GeanyDocument *doc, const gchar *search_text, GeanyFindFlags flags,
+		gboolean code_only)
 {
 	gchar *buffer, *short_file_name;
 	struct Sci_TextToFind ttf;
 	gint count = 0;
 	gint prev_line = -1;
+	gint lexer;
 	GSList *match, *matches;
 
 	g_return_val_if_fail(DOC_VALID(doc), 0);
@@ -2159,12 +2713,29 @@ static gint find_document_usage(GeanyDocument *doc, const gchar *search_text, Ge
 	ttf.chrg.cpMax = sci_get_length(doc->editor->sci);
 	ttf.lpstrText = (gchar *)search_text;
 
+	lexer = sci_get_lexer(doc->editor->sci);
 	matches = find_range(doc->editor->sci, flags, &ttf);
+	if (code_only && matches)
+	{
+		const GeanyMatchInfo *last = g_slist_last(matches)->data;
+		const gint end_styled = (gint) SSM(doc->editor->sci, SCI_GETENDSTYLED, 0, 0);
+
+		/* the styles are needed up to the last match, continue from the styled part */
+		if (end_styled < last->end)
+			sci_colourise(doc->editor->sci, sci_get_position_from_line(doc->editor->sci,
+				sci_get_line_from_position(doc->editor->sci, end_styled)), last->end);
+	}
 	foreach_slist (match, matches)
 	{
 		GeanyMatchInfo *info = match->data;
 		gint line = sci_get_line_from_position(doc->editor->sci, info->start);
 
+		if (code_only &&
+			! highlighting_is_code_style(lexer, sci_get_style_at(doc->editor->sci, info->start)))
+		{
+			geany_match_info_free(info);
+			continue;
+		}
 		if (line != prev_line)
 		{
 			buffer = sci_get_line(doc->editor->sci, line);
@@ -2198,12 +2769,13 @@ void search_find_usage(const gchar *search_text, const gchar *original_search_te
 		return;
 	}
 
+	workspace_usage_cancel();
 	gtk_notebook_set_current_page(GTK_NOTEBOOK(msgwindow.notebook), MSG_MESSAGE);
-	gtk_list_store_clear(msgwindow.store_msg);
+	msgwin_clear_tab(MSG_MESSAGE);
 
 	if (! in_session)
 	{	/* use current document */
-		count = find_document_usage(doc, search_text, flags);
+		count = find_document_usage(doc, search_text, flags, FALSE);
 	}
 	else
 	{
@@ -2212,11 +2784,63 @@ void search_find_usage(const gchar *search_text, const gchar *original_search_te
 		{
 			if (documents[i]->is_valid)
 			{
-				count += find_document_usage(documents[i], search_text, flags);
+				count += find_document_usage(documents[i], search_text, flags, FALSE);
 			}
 		}
 	}
 
+	show_usage_count(count, original_search_text);
+}
+
+
+/* Find Usage in the workspace, see search_find_workspace_usage() */
+typedef struct UsageSearch
+{
+	gint generation;
+	GRegex *regex;
+	gchar *original_search_text;
+	gint pending;	/* files still being searched, changed atomically */
+	gint count;
+}
+UsageSearch;
+
+typedef struct UsageFile
+{
+	UsageSearch *search;
+	gchar *locale_filename;
+	gchar *utf8_filename;
+	/* comment syntax of the filetype, NULL to not skip comments and strings */
+	gchar *comment_single;
+	gchar *comment_open;
+	gchar *comment_close;
+	GPtrArray *messages;	/* found lines, as for the Messages tab */
+	gint count;
+}
+UsageFile;
+
+/* Tells which parts of a file are code, guessing comments and strings from the filetype's
+ * comment syntax and quotes. It only moves forward. */
+typedef struct CodeScanner
+{
+	const UsageFile *file;
+	gsize pos;
+	enum {SCAN_CODE, SCAN_LINE_COMMENT, SCAN_BLOCK_COMMENT, SCAN_STRING} state;
+	gchar quote;
+}
+CodeScanner;
+
+/* incremented to cancel a running search, read from the search threads */
+static gint usage_generation = 0;
+static gboolean usage_searching = FALSE;
+static GThreadPool *usage_pool = NULL;
+/* searched files waiting for on_usage_files_searched(), protected by usage_results lock */
+static GSList *usage_results = NULL;
+static guint usage_results_source_id = 0;
+G_LOCK_DEFINE_STATIC(usage_results);
+
+
+static void show_usage_count(gint count, const gchar *original_search_text)
+{
 	if (count == 0) /* no matches were found */
 	{
 		ui_set_statusbar(FALSE, _("No matches found for \"%s\"."), original_search_text);
@@ -2234,6 +2858,404 @@ void search_find_usage(const gchar *search_text, const gchar *original_search_te
 }
 
 
+/* Makes results of a running workspace usage search be ignored */
+static void workspace_usage_cancel(void)
+{
+	g_atomic_int_inc(&usage_generation);
+	if (usage_searching)
+	{
+		ui_progress_bar_stop();
+		usage_searching = FALSE;
+	}
+}
+
+
+static void usage_file_free(UsageFile *file)
+{
+	g_ptr_array_free(file->messages, TRUE);
+	g_free(file->locale_filename);
+	g_free(file->utf8_filename);
+	g_free(file->comment_single);
+	g_free(file->comment_open);
+	g_free(file->comment_close);
+	g_free(file);
+}
+
+
+static void usage_search_free(UsageSearch *search)
+{
+	g_regex_unref(search->regex);
+	g_free(search->original_search_text);
+	g_free(search);
+}
+
+
+/* Called once for each file of a search and once after queueing them, in any thread */
+static void usage_search_finish_file(UsageSearch *search)
+{
+	if (! g_atomic_int_dec_and_test(&search->pending))
+		return;
+
+	/* only the main thread can see a current search finish, the threads
+	 * only finish files of cancelled searches */
+	if (search->generation == g_atomic_int_get(&usage_generation))
+	{
+		show_usage_count(search->count, search->original_search_text);
+		ui_progress_bar_stop();
+		usage_searching = FALSE;
+	}
+	usage_search_free(search);
+}
+
+
+static void workspace_usage_finalize(void)
+{
+	GSList *node;
+
+	if (! usage_pool)
+		return;
+
+	/* the threads drop the files still queued when they see the search is cancelled */
+	g_atomic_int_inc(&usage_generation);
+	g_thread_pool_free(usage_pool, FALSE, TRUE);
+	usage_pool = NULL;
+
+	/* free the results the main loop didn't get to */
+	if (usage_results_source_id)
+	{
+		g_source_remove(usage_results_source_id);
+		usage_results_source_id = 0;
+	}
+	foreach_slist(node, usage_results)
+	{
+		UsageFile *file = node->data;
+		UsageSearch *search = file->search;
+
+		usage_file_free(file);
+		usage_search_finish_file(search);
+	}
+	g_slist_free(usage_results);
+	usage_results = NULL;
+}
+
+
+static gboolean has_prefix_len(const gchar *text, gsize len, const gchar *prefix)
+{
+	const gsize prefix_len = strlen(prefix);
+
+	return prefix_len <= len && memcmp(text, prefix, prefix_len) == 0;
+}
+
+
+/* Returns whether @a pos in the @a len bytes at @a text is code, @a pos must not be before
+ * the last position asked for. */
+static gboolean code_scanner_is_code(CodeScanner *scanner, const gchar *text, gsize len, gsize pos)
+{
+	const UsageFile *file = scanner->file;
+
+	while (scanner->pos < pos)
+	{
+		const gchar *p = text + scanner->pos;
+		const gsize left = len - scanner->pos;
+
+		switch (scanner->state)
+		{
+			case SCAN_CODE:
+				if (file->comment_single && has_prefix_len(p, left, file->comment_single))
+				{
+					scanner->state = SCAN_LINE_COMMENT;
+					scanner->pos += strlen(file->comment_single);
+					continue;
+				}
+				if (file->comment_open && file->comment_close &&
+					has_prefix_len(p, left, file->comment_open))
+				{
+					scanner->state = SCAN_BLOCK_COMMENT;
+					scanner->pos += strlen(file->comment_open);
+					continue;
+				}
+				if (*p == '"' || *p == '\'')
+				{
+					scanner->state = SCAN_STRING;
+					scanner->quote = *p;
+				}
+				break;
+			case SCAN_LINE_COMMENT:
+				if (*p == '\n')
+					scanner->state = SCAN_CODE;
+				break;
+			case SCAN_BLOCK_COMMENT:
+				if (has_prefix_len(p, left, file->comment_close))
+				{
+					scanner->state = SCAN_CODE;
+					scanner->pos += strlen(file->comment_close);
+					continue;
+				}
+				break;
+			case SCAN_STRING:
+				if (*p == '\\')
+				{
+					scanner->pos += 2;
+					continue;
+				}
+				/* also end unterminated strings at the line end */
+				if (*p == scanner->quote || *p == '\n')
+					scanner->state = SCAN_CODE;
+				break;
+		}
+		scanner->pos++;
+	}
+	return scanner->state == SCAN_CODE;
+}
+
+
+/* Collects the lines of the @a len bytes at @a text with matches of the search of @a file.
+ * Runs in a search thread. */
+static void find_usage_in_text(UsageFile *file, const gchar *text, gsize len)
+{
+	CodeScanner scanner = { file, 0, SCAN_CODE, 0 };
+	const gboolean code_only = file->comment_single || file->comment_open;
+	GMatchInfo *info;
+	gsize line_start = 0;
+	gint line = 0, prev_line = -1;
+
+	g_regex_match_full(file->search->regex, text, len, 0, 0, &info, NULL);
+	while (g_match_info_matches(info))
+	{
+		gint start, end;
+
+		g_match_info_fetch_pos(info, 0, &start, &end);
+		if (! code_only || code_scanner_is_code(&scanner, text, len, start))
+		{
+			const gchar *nl;
+
+			while ((nl = memchr(text + line_start, '\n', start - line_start)) != NULL)
+			{
+				line++;
+				line_start = nl - text + 1;
+			}
+			if (line != prev_line)
+			{
+				const gchar *line_end = memchr(text + line_start, '\n', len - line_start);
+				gchar *line_text = g_strndup(text + line_start,
+					line_end ? (gsize) (line_end - text) - line_start : len - line_start);
+
+				if (! g_utf8_validate(line_text, -1, NULL))
+					SETPTR(line_text, g_convert(line_text, -1, "UTF-8", "ISO-8859-1", NULL, NULL, NULL));
+				g_ptr_array_add(file->messages, g_strdup_printf("%s:%d: %s",
+					file->utf8_filename, line + 1, line_text ? g_strstrip(line_text) : ""));
+				g_free(line_text);
+				prev_line = line;
+			}
+			file->count++;
+		}
+		if (g_atomic_int_get(&usage_generation) != file->search->generation)
+			break;
+		g_match_info_next(info, NULL);
+	}
+	g_match_info_free(info);
+}
+
+
+/* Adds the results of the searched files to the Messages tab, in the main thread. */
+static gboolean on_usage_files_searched(gpointer data)
+{
+	GSList *files, *node;
+
+	G_LOCK(usage_results);
+	files = g_slist_reverse(usage_results);
+	usage_results = NULL;
+	usage_results_source_id = 0;
+	G_UNLOCK(usage_results);
+
+	foreach_slist(node, files)
+	{
+		UsageFile *file = node->data;
+		UsageSearch *search = file->search;
+		guint i;
+
+		if (search->generation == g_atomic_int_get(&usage_generation))
+		{
+			for (i = 0; i < file->messages->len; i++)
+				msgwin_msg_add_string(COLOR_BLACK, -1, NULL, g_ptr_array_index(file->messages, i));
+			search->count += file->count;
+		}
+		usage_file_free(file);
+		usage_search_finish_file(search);
+	}
+	g_slist_free(files);
+	return FALSE;
+}
+
+
+static void search_usage_file(gpointer data, gpointer user_data)
+{
+	UsageFile *file = data;
+	UsageSearch *search = file->search;
+	GMappedFile *mapped;
+
+	if (g_atomic_int_get(&usage_generation) != search->generation)
+	{
+		/* cancelled, also when the pool is freed with files still queued */
+		usage_file_free(file);
+		usage_search_finish_file(search);
+		return;
+	}
+
+	/* files can be big and are only read once, so don't copy them */
+	mapped = g_mapped_file_new(file->locale_filename, FALSE, NULL);
+	if (mapped)
+	{
+		const gchar *text = g_mapped_file_get_contents(mapped);
+
+		if (text)
+			find_usage_in_text(file, text, g_mapped_file_get_length(mapped));
+		g_mapped_file_unref(mapped);
+	}
+
+	G_LOCK(usage_results);
+	usage_results = g_slist_prepend(usage_results, file);
+	if (! usage_results_source_id)
+		usage_results_source_id = g_idle_add(on_usage_files_searched, NULL);
+	G_UNLOCK(usage_results);
+}
+
+
+static UsageFile *usage_file_new(UsageSearch *search, const TMSourceFile *source_file)
+{
+	UsageFile *file = g_new0(UsageFile, 1);
+	guint i;
+
+	file->search = search;
+	file->locale_filename = g_strdup(source_file->file_name);
+	file->utf8_filename = utils_get_utf8_from_locale(source_file->file_name);
+	file->messages = g_ptr_array_new_with_free_func(g_free);
+
+	/* the tags' language tells the comment syntax */
+	for (i = 0; source_file->lang >= 0 && i < filetypes_array->len; i++)
+	{
+		const GeanyFiletype *ft = filetypes[i];
+
+		if (ft->lang == source_file->lang)
+		{
+			file->comment_single = EMPTY(ft->comment_single) ? NULL : g_strdup(ft->comment_single);
+			if (! EMPTY(ft->comment_open) && ! EMPTY(ft->comment_close))
+			{
+				file->comment_open = g_strdup(ft->comment_open);
+				file->comment_close = g_strdup(ft->comment_close);
+			}
+			break;
+		}
+	}
+	return file;
+}
+
+
+static GRegex *compile_usage_regex(const gchar *search_text, GeanyFindFlags flags)
+{
+	GRegex *regex;
+	GError *error = NULL;
+	/* files are searched as they are, they needn't be valid UTF-8 */
+	gint rflags = G_REGEX_MULTILINE | G_REGEX_RAW | G_REGEX_OPTIMIZE;
+	gchar *pattern;
+
+	if (~flags & GEANY_FIND_MATCHCASE)
+		rflags |= G_REGEX_CASELESS;
+
+	if (flags & GEANY_FIND_REGEXP)
+		pattern = g_strdup(search_text);
+	else
+	{
+		gchar *escaped = g_regex_escape_string(search_text, -1);
+
+		if (flags & GEANY_FIND_WHOLEWORD)
+			pattern = g_strconcat("(?<!\\w)", escaped, "(?!\\w)", NULL);
+		else if (flags & GEANY_FIND_WORDSTART)
+			pattern = g_strconcat("(?<!\\w)", escaped, NULL);
+		else
+			pattern = g_strdup(escaped);
+		g_free(escaped);
+	}
+
+	regex = g_regex_new(pattern, rflags, 0, &error);
+	if (!regex)
+	{
+		ui_set_statusbar(FALSE, _("Bad regex: %s"), error->message);
+		g_error_free(error);
+	}
+	g_free(pattern);
+	return regex;
+}
+
+
+/* Like search_find_usage() in the session, but also searches all other source files of the
+ * tag manager workspace, skipping matches in comments and strings.
+ * Files which aren't open are searched by several threads and their matches are added
+ * to the Messages tab as each file is done. */
+void search_find_workspace_usage(const gchar *search_text, const gchar *original_search_text,
+		GeanyFindFlags flags)
+{
+	GPtrArray *source_files = app->tm_workspace->source_files;
+	GHashTable *open_files;
+	UsageSearch *search;
+	GRegex *regex;
+	guint i;
+
+	if (G_UNLIKELY(EMPTY(search_text)))
+	{
+		utils_beep();
+		return;
+	}
+	regex = compile_usage_regex(search_text, flags);
+	if (! regex)
+		return;
+
+	workspace_usage_cancel();
+	gtk_notebook_set_current_page(GTK_NOTEBOOK(msgwindow.notebook), MSG_MESSAGE);
+	msgwin_clear_tab(MSG_MESSAGE);
+
+	search = g_new0(UsageSearch, 1);
+	search->generation = g_atomic_int_get(&usage_generation);
+	search->regex = regex;
+	search->original_search_text = g_strdup(original_search_text);
+	search->pending = 1;	/* until all files are queued */
+
+	/* open documents may have unsaved changes, so search their text */
+	open_files = g_hash_table_new(g_direct_hash, g_direct_equal);
+	foreach_document(i)
+	{
+		search->count += find_document_usage(documents[i], search_text, flags, TRUE);
+		if (documents[i]->tm_file)
+			g_hash_table_add(open_files, documents[i]->tm_file);
+	}
+
+	if (! usage_pool)
+	{
+#if GLIB_CHECK_VERSION(2, 36, 0)
+		const gint max_threads = g_get_num_processors();
+#else
+		const gint max_threads = 4;
+#endif
+		usage_pool = g_thread_pool_new(search_usage_file, NULL, max_threads, FALSE, NULL);
+	}
+	for (i = 0; i < source_files->len; i++)
+	{
+		TMSourceFile *source_file = g_ptr_array_index(source_files, i);
+
+		if (! g_hash_table_contains(open_files, source_file))
+		{
+			search->pending++;
+			g_thread_pool_push(usage_pool, usage_file_new(search, source_file), NULL);
+		}
+	}
+	g_hash_table_destroy(open_files);
+
+	usage_searching = TRUE;
+	ui_progress_bar_start(_("Searching..."));
+	usage_search_finish_file(search);
+}
+
+
 /* ttf is updated to include the last match position (ttf->chrg.cpMin) and
  * the new search range end (ttf->chrg.cpMax).
  * Note: Normally you would call sci_start/end_undo_action() around this call. */
@@ -2249,15 +3271,27 @@ guint search_replace_range(ScintillaObject *sci, struct Sci_TextToFind *ttf,
 		return 0;
 
 	matches = find_range(sci, flags, ttf);
+	if (! matches)
+		return 0;
+
+	/* all the replacements are a single undo action */
+	sci_start_undo_action(sci);
+
 	foreach_slist (match, matches)
 	{
 		GeanyMatchInfo *info = match->data;
+		const gchar *match_text = NULL;
 		gint replace_len;
 
 		info->start += offset;
 		info->end += offset;
 
-		replace_len = search_replace_match(sci, info, replace_text);
+		/* the groups of regex matches are read in place, the matches before were replaced
+		 * already so this doesn't move the gap */
+		if (info->flags & GEANY_FIND_REGEXP)
+			match_text = (const gchar *) SSM(sci, SCI_GETRANGEPOINTER, info->start,
+				info->end - info->start);
+		replace_len = replace_match(sci, info, match_text, replace_text);
 		offset += replace_len - (info->end - info->start);
 		count ++;
 
@@ -2272,6 +3306,8 @@ guint search_replace_range(ScintillaObject *sci, struct Sci_TextToFind *ttf,
 	}
 	g_slist_free(matches);
 
+	sci_end_undo_action(sci);
+
 	return count;
 }
 
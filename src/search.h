@@ -62,6 +62,7 @@ typedef struct GeanySearchPrefs
 	gboolean	hide_find_dialog;		/* hide the find dialog on next or previous */
 	gboolean	replace_and_find_by_default;	/* enter in replace window performs Replace & Find instead of Replace */
 	GeanyFindSelOptions find_selection_type;
+	gboolean	project_search_index;	/* hidden pref */
 }
 GeanySearchPrefs;
 
@@ -131,15 +132,25 @@ void search_find_again(gboolean change_direction);
 
 void search_find_usage(const gchar *search_text, const gchar *original_search_text, GeanyFindFlags flags, gboolean in_session);
 
+void search_find_workspace_usage(const gchar *search_text, const gchar *original_search_text,
+		GeanyFindFlags flags);
+
 void search_find_selection(struct GeanyDocument *doc, gboolean search_backwards);
 
 gint search_mark_all(struct GeanyDocument *doc, const gchar *search_text, GeanyFindFlags flags);
 
+void search_mark_all_in_background(struct GeanyDocument *doc, const gchar *search_text, GeanyFindFlags flags);
+
+void search_mark_all_text_changed(struct GeanyDocument *doc, gint position, gint length,
+		gboolean inserted);
+
 gint search_replace_match(struct _ScintillaObject *sci, const GeanyMatchInfo *match, const gchar *replace_text);
 
 guint search_replace_range(struct _ScintillaObject *sci, struct Sci_TextToFind *ttf,
 		GeanyFindFlags flags, const gchar *replace_text);
 
+gchar *search_get_regex_required_literal(const gchar *pattern, gboolean caseless);
+
 #endif /* GEANY_PRIVATE */
 
 G_END_DECLS
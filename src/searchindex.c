@@ -0,0 +1,899 @@
+/*
+ *      searchindex.c - this file is part of Geany, a fast and lightweight IDE
+ *
+ *      Copyright 2018 The Geany contributors
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with this program; if not, write to the Free Software Foundation, Inc.,
+ *      51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Trigram index of the files below the base path of the open project.
+ *
+ * For each trigram (three consecutive bytes of a line, with ASCII letters lowercased)
+ * the index keeps the files containing it, so searches for a literal only need to
+ * look at the files containing all its trigrams.
+ * The index is built in the background when opening a project, kept up to date from
+ * file monitors and document saves, and saved in the configuration directory so only
+ * changed files need to be read again next time.
+ * It covers the files "grep -r" reads: all regular files, including hidden ones, but no
+ * symbolic links. If a directory can't be monitored, the index is disabled as it could
+ * become outdated without noticing.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "searchindex.h"
+
+#include "app.h"
+#include "document.h"
+#include "geany.h"
+#include "geanyobject.h"
+#include "project.h"
+#include "search.h"
+#include "utils.h"
+
+#include <string.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+
+#define INDEX_MAGIC 0x47495831	/* "GIX1", also tells about the byte order */
+#define MAX_INDEXED_FILE_SIZE (16 * 1024 * 1024)
+/* how long to index in each idle call, in microseconds */
+#define INDEX_TIME_SLICE 20000
+
+enum
+{
+	FILE_REMOVED = 1 << 0,	/* replaced by a newer entry or deleted */
+	FILE_UNINDEXED = 1 << 1	/* too big to index, so always a candidate */
+};
+
+typedef struct IndexedFile
+{
+	gchar *path;	/* relative to the base path, in locale encoding */
+	gint64 mtime;
+	gint64 size;
+	guint flags;
+	gboolean seen;	/* found by the current crawl */
+}
+IndexedFile;
+
+static struct
+{
+	gchar *base_path;	/* real path, in locale encoding */
+	gchar *index_file;
+	GPtrArray *files;	/* IndexedFile, the position is the file ID */
+	GHashTable *file_ids;	/* path -> ID + 1 of the current entry */
+	GHashTable *postings;	/* trigram -> GArray of the IDs of the files containing it, ascending */
+	guint removed_count;
+	GQueue *dirs;	/* directories left to crawl, relative to the base path */
+	GHashTable *pending;	/* files to (re)index, relative to the base path */
+	GPtrArray *monitors;
+	gboolean ready;	/* whether the first crawl is complete */
+	gboolean disabled;	/* whether the index can't be kept up to date */
+	gboolean dirty;	/* whether the index changed since it was saved */
+	guint source_id;
+}
+idx;
+
+/* bit set of the trigrams already found in the file being indexed */
+static guint8 *trigram_seen = NULL;
+
+
+static void indexed_file_free(gpointer data)
+{
+	IndexedFile *file = data;
+
+	g_free(file->path);
+	g_free(file);
+}
+
+
+static void posting_free(gpointer data)
+{
+	g_array_free(data, TRUE);
+}
+
+
+static void index_clear(void)
+{
+	if (idx.files)
+		g_ptr_array_free(idx.files, TRUE);
+	if (idx.file_ids)
+		g_hash_table_destroy(idx.file_ids);
+	if (idx.postings)
+		g_hash_table_destroy(idx.postings);
+
+	idx.files = g_ptr_array_new_with_free_func(indexed_file_free);
+	idx.file_ids = g_hash_table_new(g_str_hash, g_str_equal);
+	idx.postings = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, posting_free);
+	idx.removed_count = 0;
+}
+
+
+static IndexedFile *lookup_file(const gchar *path)
+{
+	guint id = GPOINTER_TO_UINT(g_hash_table_lookup(idx.file_ids, path));
+
+	return id ? g_ptr_array_index(idx.files, id - 1) : NULL;
+}
+
+
+static void remove_file(IndexedFile *file)
+{
+	g_hash_table_remove(idx.file_ids, file->path);
+	file->flags |= FILE_REMOVED;
+	idx.removed_count++;
+	idx.dirty = TRUE;
+}
+
+
+static guint add_file(const gchar *path, gint64 mtime, gint64 size, guint flags)
+{
+	IndexedFile *file = g_new0(IndexedFile, 1);
+
+	file->path = g_strdup(path);
+	file->mtime = mtime;
+	file->size = size;
+	file->flags = flags;
+	file->seen = TRUE;
+	g_ptr_array_add(idx.files, file);
+	g_hash_table_replace(idx.file_ids, file->path, GUINT_TO_POINTER(idx.files->len));
+	idx.dirty = TRUE;
+	return idx.files->len - 1;
+}
+
+
+/* Returns the trigrams of @a text, or NULL if it is binary.
+ * Trigrams never span line ends, as matches of searches never do. */
+static GArray *get_trigrams(const gchar *text, gsize len)
+{
+	GArray *trigrams = g_array_new(FALSE, FALSE, sizeof(guint32));
+	guint32 trigram = 0;
+	guint run = 0;
+	gsize i;
+
+	if (! trigram_seen)
+		trigram_seen = g_malloc0((1 << 24) / 8);
+
+	for (i = 0; i < len; i++)
+	{
+		const guchar c = g_ascii_tolower(text[i]);
+
+		if (c == 0)
+			break;
+		if (c == '\n' || c == '\r')
+		{
+			run = 0;
+			continue;
+		}
+		/* as there are no NULs, no trigram is 0 */
+		trigram = ((trigram << 8) | c) & 0xffffff;
+		if (++run >= 3 && ! (trigram_seen[trigram >> 3] & (1 << (trigram & 7))))
+		{
+			trigram_seen[trigram >> 3] |= 1 << (trigram & 7);
+			g_array_append_val(trigrams, trigram);
+		}
+	}
+	for (run = 0; run < trigrams->len; run++)
+	{
+		trigram = g_array_index(trigrams, guint32, run);
+		trigram_seen[trigram >> 3] &= ~(1 << (trigram & 7));
+	}
+	if (i < len)
+	{
+		g_array_free(trigrams, TRUE);
+		return NULL;
+	}
+	return trigrams;
+}
+
+
+static void index_file(const gchar *path, gint64 mtime, gint64 size)
+{
+	gchar *locale_filename = g_build_filename(idx.base_path, path, NULL);
+	gchar *contents;
+	gsize len;
+	GArray *trigrams;
+	guint id, i;
+
+	if (size > MAX_INDEXED_FILE_SIZE)
+	{
+		add_file(path, mtime, size, FILE_UNINDEXED);
+		g_free(locale_filename);
+		return;
+	}
+	if (! g_file_get_contents(locale_filename, &contents, &len, NULL))
+	{
+		g_free(locale_filename);
+		return;
+	}
+	g_free(locale_filename);
+
+	trigrams = get_trigrams(contents, len);
+	g_free(contents);
+	/* binary files are added without trigrams, like grep ignores them */
+	id = add_file(path, mtime, size, 0);
+	if (! trigrams)
+		return;
+
+	for (i = 0; i < trigrams->len; i++)
+	{
+		gpointer key = GUINT_TO_POINTER(g_array_index(trigrams, guint32, i));
+		GArray *posting = g_hash_table_lookup(idx.postings, key);
+
+		if (! posting)
+		{
+			posting = g_array_new(FALSE, FALSE, sizeof(guint));
+			g_hash_table_insert(idx.postings, key, posting);
+		}
+		/* IDs only grow, so the posting stays sorted */
+		g_array_append_val(posting, id);
+	}
+	g_array_free(trigrams, TRUE);
+}
+
+
+/* Drops removed files, renumbering the others. */
+static void compact_index(void)
+{
+	guint *new_ids;
+	GPtrArray *files;
+	GHashTableIter iter;
+	gpointer value;
+	guint i;
+
+	if (idx.removed_count == 0)
+		return;
+
+	new_ids = g_new(guint, idx.files->len);
+	files = g_ptr_array_new_with_free_func(indexed_file_free);
+	g_hash_table_remove_all(idx.file_ids);
+	for (i = 0; i < idx.files->len; i++)
+	{
+		IndexedFile *file = g_ptr_array_index(idx.files, i);
+
+		if (file->flags & FILE_REMOVED)
+		{
+			new_ids[i] = G_MAXUINT;
+			indexed_file_free(file);
+			continue;
+		}
+		new_ids[i] = files->len;
+		g_ptr_array_add(files, file);
+		g_hash_table_insert(idx.file_ids, file->path, GUINT_TO_POINTER(files->len));
+	}
+	/* the files were moved, not freed */
+	g_ptr_array_set_free_func(idx.files, NULL);
+	g_ptr_array_free(idx.files, TRUE);
+	idx.files = files;
+
+	g_hash_table_iter_init(&iter, idx.postings);
+	while (g_hash_table_iter_next(&iter, NULL, &value))
+	{
+		GArray *posting = value;
+		guint j, n = 0;
+
+		for (j = 0; j < posting->len; j++)
+		{
+			guint id = new_ids[g_array_index(posting, guint, j)];
+
+			if (id != G_MAXUINT)
+				g_array_index(posting, guint, n++) = id;
+		}
+		if (n == 0)
+			g_hash_table_iter_remove(&iter);
+		else
+			g_array_set_size(posting, n);
+	}
+	g_free(new_ids);
+	idx.removed_count = 0;
+}
+
+
+static void append_u32(GByteArray *data, guint32 value)
+{
+	g_byte_array_append(data, (const guint8 *) &value, sizeof value);
+}
+
+
+static void append_i64(GByteArray *data, gint64 value)
+{
+	g_byte_array_append(data, (const guint8 *) &value, sizeof value);
+}
+
+
+static void save_index(void)
+{
+	GByteArray *data;
+	GHashTableIter iter;
+	gpointer key, value;
+	gchar *dir;
+	guint i;
+
+	if (! idx.dirty)
+		return;
+
+	compact_index();
+	data = g_byte_array_new();
+	append_u32(data, INDEX_MAGIC);
+	append_u32(data, idx.files->len);
+	for (i = 0; i < idx.files->len; i++)
+	{
+		IndexedFile *file = g_ptr_array_index(idx.files, i);
+		const guint32 len = strlen(file->path);
+
+		append_u32(data, file->flags);
+		append_i64(data, file->mtime);
+		append_i64(data, file->size);
+		append_u32(data, len);
+		g_byte_array_append(data, (const guint8 *) file->path, len);
+	}
+	append_u32(data, g_hash_table_size(idx.postings));
+	g_hash_table_iter_init(&iter, idx.postings);
+	while (g_hash_table_iter_next(&iter, &key, &value))
+	{
+		GArray *posting = value;
+
+		append_u32(data, GPOINTER_TO_UINT(key));
+		append_u32(data, posting->len);
+		for (i = 0; i < posting->len; i++)
+			append_u32(data, g_array_index(posting, guint, i));
+	}
+
+	dir = g_path_get_dirname(idx.index_file);
+	utils_mkdir(dir, TRUE);
+	g_free(dir);
+	if (g_file_set_contents(idx.index_file, (const gchar *) data->data, data->len, NULL))
+		idx.dirty = FALSE;
+	g_byte_array_free(data, TRUE);
+}
+
+
+static gboolean read_bytes(const guint8 **p, const guint8 *end, gpointer dest, gsize len)
+{
+	if ((gsize) (end - *p) < len)
+		return FALSE;
+	memcpy(dest, *p, len);
+	*p += len;
+	return TRUE;
+}
+
+
+static gboolean parse_index(const guint8 *p, const guint8 *end)
+{
+	guint32 magic, n_files, n_trigrams, i, j;
+
+	if (! read_bytes(&p, end, &magic, sizeof magic) || magic != INDEX_MAGIC ||
+		! read_bytes(&p, end, &n_files, sizeof n_files))
+		return FALSE;
+
+	for (i = 0; i < n_files; i++)
+	{
+		guint32 flags, len;
+		gint64 mtime, size;
+		gchar *path;
+		guint id;
+
+		if (! read_bytes(&p, end, &flags, sizeof flags) ||
+			! read_bytes(&p, end, &mtime, sizeof mtime) ||
+			! read_bytes(&p, end, &size, sizeof size) ||
+			! read_bytes(&p, end, &len, sizeof len) || (gsize) (end - p) < len)
+			return FALSE;
+		path = g_strndup((const gchar *) p, len);
+		p += len;
+		id = add_file(path, mtime, size, flags & FILE_UNINDEXED);
+		/* until the crawl finds it */
+		((IndexedFile *) g_ptr_array_index(idx.files, id))->seen = FALSE;
+		g_free(path);
+	}
+
+	if (! read_bytes(&p, end, &n_trigrams, sizeof n_trigrams))
+		return FALSE;
+	for (i = 0; i < n_trigrams; i++)
+	{
+		guint32 trigram, len;
+		GArray *posting;
+
+		if (! read_bytes(&p, end, &trigram, sizeof trigram) ||
+			! read_bytes(&p, end, &len, sizeof len) || trigram == 0 ||
+			(gsize) (end - p) / sizeof(guint32) < len)
+			return FALSE;
+
+		posting = g_array_sized_new(FALSE, FALSE, sizeof(guint), len);
+		g_hash_table_insert(idx.postings, GUINT_TO_POINTER(trigram), posting);
+		for (j = 0; j < len; j++)
+		{
+			guint32 id;
+
+			read_bytes(&p, end, &id, sizeof id);
+			if (id >= n_files)
+				return FALSE;
+			g_array_append_val(posting, id);
+		}
+	}
+	return p == end;
+}
+
+
+static void load_index(void)
+{
+	gchar *contents;
+	gsize len;
+
+	if (! g_file_get_contents(idx.index_file, &contents, &len, NULL))
+		return;
+
+	if (! parse_index((const guint8 *) contents, (const guint8 *) contents + len))
+	{
+		geany_debug("Ignoring invalid search index %s", idx.index_file);
+		index_clear();
+	}
+	g_free(contents);
+	idx.dirty = FALSE;
+}
+
+
+static void on_monitor_changed(GFileMonitor *monitor, GFile *file, GFile *other_file,
+		GFileMonitorEvent event, gpointer user_data);
+
+
+static void monitor_dir(const gchar *path)
+{
+	gchar *locale_dir = g_build_filename(idx.base_path, path, NULL);
+	GFile *dir = g_file_new_for_path(locale_dir);
+	GError *error = NULL;
+	GFileMonitor *monitor = g_file_monitor_directory(dir, G_FILE_MONITOR_NONE, NULL, &error);
+
+	if (monitor)
+	{
+		g_signal_connect(monitor, "changed", G_CALLBACK(on_monitor_changed), NULL);
+		g_ptr_array_add(idx.monitors, monitor);
+	}
+	else
+	{
+		/* e.g. when running out of inotify watches */
+		geany_debug("Disabling the search index of %s, can't monitor %s: %s",
+			idx.base_path, locale_dir, error->message);
+		g_error_free(error);
+		idx.disabled = TRUE;
+	}
+	g_object_unref(dir);
+	g_free(locale_dir);
+}
+
+
+/* Queues the files of a directory and its subdirectories to be crawled. */
+static void crawl_dir(const gchar *path)
+{
+	gchar *locale_dir = g_build_filename(idx.base_path, path, NULL);
+	GDir *dir = g_dir_open(locale_dir, 0, NULL);
+	const gchar *name;
+
+	g_free(locale_dir);
+	if (! dir)
+		return;
+
+	monitor_dir(path);
+	while ((name = g_dir_read_name(dir)) != NULL)
+	{
+		gchar *child = *path ? g_build_filename(path, name, NULL) : g_strdup(name);
+		gchar *locale_filename = g_build_filename(idx.base_path, child, NULL);
+
+		/* like grep -r, don't follow symbolic links */
+		if (g_file_test(locale_filename, G_FILE_TEST_IS_SYMLINK))
+			g_free(child);
+		else if (g_file_test(locale_filename, G_FILE_TEST_IS_DIR))
+			g_queue_push_tail(idx.dirs, child);
+		else
+			g_hash_table_add(idx.pending, child);
+		g_free(locale_filename);
+	}
+	g_dir_close(dir);
+}
+
+
+/* Brings the index up to date with the file at @a path. */
+static void update_file(const gchar *path)
+{
+	gchar *locale_filename = g_build_filename(idx.base_path, path, NULL);
+	IndexedFile *file = lookup_file(path);
+	GStatBuf st;
+
+	if (g_file_test(locale_filename, G_FILE_TEST_IS_SYMLINK) || g_stat(locale_filename, &st) != 0 ||
+		! g_file_test(locale_filename, G_FILE_TEST_IS_REGULAR))
+	{
+		if (file)
+			remove_file(file);
+		/* a new directory */
+		if (g_file_test(locale_filename, G_FILE_TEST_IS_DIR) &&
+			! g_file_test(locale_filename, G_FILE_TEST_IS_SYMLINK))
+			g_queue_push_tail(idx.dirs, g_strdup(path));
+	}
+	else if (file && file->mtime == (gint64) st.st_mtime && file->size == (gint64) st.st_size)
+		file->seen = TRUE;
+	else
+	{
+		if (file)
+			remove_file(file);
+		index_file(path, st.st_mtime, st.st_size);
+	}
+	g_free(locale_filename);
+}
+
+
+static void finish_crawl(void)
+{
+	guint i;
+
+	/* forget files deleted while the project was closed */
+	for (i = 0; i < idx.files->len; i++)
+	{
+		IndexedFile *file = g_ptr_array_index(idx.files, i);
+
+		if (! file->seen && ! (file->flags & FILE_REMOVED))
+			remove_file(file);
+	}
+	idx.ready = TRUE;
+	save_index();
+}
+
+
+static gboolean index_in_idle(gpointer data)
+{
+	const gint64 end_time = g_get_monotonic_time() + INDEX_TIME_SLICE;
+
+	do
+	{
+		if (idx.disabled)
+		{
+			idx.source_id = 0;
+			return FALSE;
+		}
+		if (g_hash_table_size(idx.pending) > 0)
+		{
+			GHashTableIter iter;
+			gpointer path;
+
+			g_hash_table_iter_init(&iter, idx.pending);
+			g_hash_table_iter_next(&iter, &path, NULL);
+			g_hash_table_iter_steal(&iter);
+			update_file(path);
+			g_free(path);
+		}
+		else if (! g_queue_is_empty(idx.dirs))
+		{
+			gchar *path = g_queue_pop_head(idx.dirs);
+
+			crawl_dir(path);
+			g_free(path);
+		}
+		else
+		{
+			if (! idx.ready)
+				finish_crawl();
+			else if (idx.removed_count > idx.files->len / 2)
+				compact_index();
+			idx.source_id = 0;
+			return FALSE;
+		}
+	}
+	while (g_get_monotonic_time() < end_time);
+
+	return TRUE;
+}
+
+
+/* Queues the file at @a locale_filename to be indexed again, if it is below the base path. */
+static void queue_file(const gchar *locale_filename)
+{
+	const gsize base_len = strlen(idx.base_path);
+
+	if (idx.disabled || strncmp(locale_filename, idx.base_path, base_len) != 0 ||
+		! G_IS_DIR_SEPARATOR(locale_filename[base_len]))
+		return;
+
+	g_hash_table_add(idx.pending, g_strdup(locale_filename + base_len + 1));
+	if (idx.source_id == 0)
+		idx.source_id = g_idle_add(index_in_idle, NULL);
+}
+
+
+static void on_monitor_changed(GFileMonitor *monitor, GFile *file, GFile *other_file,
+		GFileMonitorEvent event, gpointer user_data)
+{
+	gchar *locale_filename;
+
+	if (event != G_FILE_MONITOR_EVENT_CHANGED && event != G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT &&
+		event != G_FILE_MONITOR_EVENT_CREATED && event != G_FILE_MONITOR_EVENT_DELETED)
+		return;
+
+	locale_filename = g_file_get_path(file);
+	if (locale_filename)
+	{
+		queue_file(locale_filename);
+		g_free(locale_filename);
+	}
+}
+
+
+static void index_close(void)
+{
+	if (! idx.base_path)
+		return;
+
+	if (idx.source_id != 0)
+		g_source_remove(idx.source_id);
+	/* only save a complete index, the next crawl would find the rest anyway */
+	if (idx.ready && ! idx.disabled)
+		save_index();
+
+	g_ptr_array_free(idx.monitors, TRUE);
+	g_queue_free_full(idx.dirs, g_free);
+	g_hash_table_destroy(idx.pending);
+	g_ptr_array_free(idx.files, TRUE);
+	g_hash_table_destroy(idx.file_ids);
+	g_hash_table_destroy(idx.postings);
+	g_free(idx.base_path);
+	g_free(idx.index_file);
+	memset(&idx, 0, sizeof idx);
+
+	g_free(trigram_seen);
+	trigram_seen = NULL;
+}
+
+
+static gchar *get_project_real_base_path(void)
+{
+	gchar *utf8_base_path = project_get_base_path();
+	gchar *locale_base_path, *real_path;
+
+	if (! utf8_base_path)
+		return NULL;
+
+	locale_base_path = utils_get_locale_from_utf8(utf8_base_path);
+	real_path = utils_get_real_path(locale_base_path);
+	g_free(locale_base_path);
+	g_free(utf8_base_path);
+	return real_path;
+}
+
+
+static void index_open(void)
+{
+	gchar *base_path;
+	gchar *checksum, *name;
+
+	if (! search_prefs.project_search_index || ! app->project)
+		return;
+
+	base_path = get_project_real_base_path();
+	if (! base_path || ! g_file_test(base_path, G_FILE_TEST_IS_DIR))
+	{
+		g_free(base_path);
+		return;
+	}
+
+	idx.base_path = base_path;
+	checksum = g_compute_checksum_for_string(G_CHECKSUM_MD5, base_path, -1);
+	name = g_strconcat(checksum, ".idx", NULL);
+	idx.index_file = g_build_filename(app->configdir, "searchindex", name, NULL);
+	g_free(checksum);
+	g_free(name);
+
+	index_clear();
+	load_index();
+
+	idx.dirs = g_queue_new();
+	idx.pending = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	idx.monitors = g_ptr_array_new_with_free_func(g_object_unref);
+	idx.ready = FALSE;
+	g_queue_push_tail(idx.dirs, g_strdup(""));
+	idx.source_id = g_idle_add(index_in_idle, NULL);
+}
+
+
+static void on_project_open(GObject *obj, GKeyFile *config, gpointer user_data)
+{
+	index_close();
+	index_open();
+}
+
+
+/* also called for new projects and after changing the base path */
+static void on_project_save(GObject *obj, GKeyFile *config, gpointer user_data)
+{
+	gchar *base_path = get_project_real_base_path();
+
+	if (! utils_str_equal(base_path, idx.base_path))
+	{
+		index_close();
+		index_open();
+	}
+	g_free(base_path);
+}
+
+
+static void on_project_close(GObject *obj, gpointer user_data)
+{
+	index_close();
+}
+
+
+static void on_document_save(GObject *obj, GeanyDocument *doc, gpointer user_data)
+{
+	if (idx.base_path && doc->real_path)
+		queue_file(doc->real_path);
+}
+
+
+void searchindex_init(void)
+{
+	g_signal_connect(geany_object, "project-open", G_CALLBACK(on_project_open), NULL);
+	g_signal_connect(geany_object, "project-save", G_CALLBACK(on_project_save), NULL);
+	g_signal_connect(geany_object, "project-close", G_CALLBACK(on_project_close), NULL);
+	g_signal_connect(geany_object, "document-save", G_CALLBACK(on_document_save), NULL);
+}
+
+
+void searchindex_finalize(void)
+{
+	index_close();
+}
+
+
+static gint compare_posting_length(gconstpointer a, gconstpointer b)
+{
+	const GArray *posting_a = *(GArray * const *) a;
+	const GArray *posting_b = *(GArray * const *) b;
+
+	return (gint) posting_a->len - (gint) posting_b->len;
+}
+
+
+/* Keeps only the IDs in @a ids which are also in @a posting, both sorted */
+static void intersect_ids(GArray *ids, const GArray *posting)
+{
+	guint i, j = 0, n = 0;
+
+	for (i = 0; i < ids->len && j < posting->len; i++)
+	{
+		const guint id = g_array_index(ids, guint, i);
+
+		while (j < posting->len && g_array_index(posting, guint, j) < id)
+			j++;
+		if (j < posting->len && g_array_index(posting, guint, j) == id)
+			g_array_index(ids, guint, n++) = id;
+	}
+	g_array_set_size(ids, n);
+}
+
+
+static gint compare_paths(gconstpointer a, gconstpointer b)
+{
+	return strcmp(*(const gchar * const *) a, *(const gchar * const *) b);
+}
+
+
+static void add_candidate(GPtrArray *result, const gchar *path, const gchar *rel_dir)
+{
+	const gsize dir_len = strlen(rel_dir);
+
+	if (dir_len == 0)
+		g_ptr_array_add(result, g_strdup(path));
+	else if (strncmp(path, rel_dir, dir_len) == 0 && G_IS_DIR_SEPARATOR(path[dir_len]))
+		g_ptr_array_add(result, g_strdup(path + dir_len + 1));
+}
+
+
+GPtrArray *searchindex_find_files(const gchar *locale_dir, const gchar *literal, gboolean caseless)
+{
+	GPtrArray *postings, *result;
+	GArray *ids = NULL;
+	GHashTable *found;
+	GHashTableIter iter;
+	gpointer path;
+	gchar *real_dir;
+	const gchar *rel_dir;
+	gsize base_len;
+	guint i;
+
+	if (! idx.base_path || ! idx.ready || idx.disabled)
+		return NULL;
+
+	real_dir = utils_get_real_path(locale_dir);
+	base_len = strlen(idx.base_path);
+	if (! real_dir || strncmp(real_dir, idx.base_path, base_len) != 0 ||
+		(real_dir[base_len] && ! G_IS_DIR_SEPARATOR(real_dir[base_len])))
+	{
+		g_free(real_dir);
+		return NULL;
+	}
+	rel_dir = real_dir[base_len] ? real_dir + base_len + 1 : "";
+
+	postings = g_ptr_array_new();
+	for (i = 0; literal[i] && literal[i + 1] && literal[i + 2]; i++)
+	{
+		const guchar *c = (const guchar *) literal + i;
+		guint32 trigram;
+
+		/* letters matching other bytes when ignoring case can't be looked up */
+		if (caseless && (c[0] >= 0x80 || c[1] >= 0x80 || c[2] >= 0x80 ||
+			strchr("kKsS", c[0]) || strchr("kKsS", c[1]) || strchr("kKsS", c[2])))
+			continue;
+
+		trigram = (g_ascii_tolower(c[0]) << 16) | (g_ascii_tolower(c[1]) << 8) | g_ascii_tolower(c[2]);
+		g_ptr_array_add(postings, g_hash_table_lookup(idx.postings, GUINT_TO_POINTER(trigram)));
+		if (! g_ptr_array_index(postings, postings->len - 1))
+		{
+			/* no file contains this trigram */
+			ids = g_array_new(FALSE, FALSE, sizeof(guint));
+			break;
+		}
+	}
+	if (postings->len == 0)
+	{
+		/* too short to narrow down */
+		g_ptr_array_free(postings, TRUE);
+		g_free(real_dir);
+		return NULL;
+	}
+
+	if (! ids)
+	{
+		/* start with the rarest trigram to keep the intersections small */
+		g_ptr_array_sort(postings, compare_posting_length);
+		ids = g_array_new(FALSE, FALSE, sizeof(guint));
+		g_array_append_vals(ids, ((GArray *) g_ptr_array_index(postings, 0))->data,
+			((GArray *) g_ptr_array_index(postings, 0))->len);
+		for (i = 1; i < postings->len && ids->len > 0; i++)
+			intersect_ids(ids, g_ptr_array_index(postings, i));
+	}
+	g_ptr_array_free(postings, TRUE);
+
+	/* files which may have changed since they were indexed are candidates anyway */
+	found = g_hash_table_new(g_str_hash, g_str_equal);
+	g_hash_table_iter_init(&iter, idx.pending);
+	while (g_hash_table_iter_next(&iter, &path, NULL))
+		g_hash_table_add(found, path);
+	for (i = 0; i < ids->len; i++)
+	{
+		IndexedFile *file = g_ptr_array_index(idx.files, g_array_index(ids, guint, i));
+
+		if (! (file->flags & FILE_REMOVED))
+			g_hash_table_add(found, file->path);
+	}
+	g_array_free(ids, TRUE);
+	for (i = 0; i < idx.files->len; i++)
+	{
+		IndexedFile *file = g_ptr_array_index(idx.files, i);
+
+		if (file->flags == FILE_UNINDEXED)
+			g_hash_table_add(found, file->path);
+	}
+
+	result = g_ptr_array_new_with_free_func(g_free);
+	g_hash_table_iter_init(&iter, found);
+	while (g_hash_table_iter_next(&iter, &path, NULL))
+		add_candidate(result, path, rel_dir);
+	g_hash_table_destroy(found);
+	/* give the same output whatever the order of the index */
+	g_ptr_array_sort(result, compare_paths);
+
+	g_free(real_dir);
+	return result;
+}
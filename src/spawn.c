@@ -98,6 +98,8 @@ static gboolean spawn_parse_argv(const gchar *command_line, gint *argcp, gchar *
 #endif
 
 #define G_IO_FAILURE (G_IO_ERR | G_IO_HUP | G_IO_NVAL)  /* always used together */
+/* line buffered output is read in larger chunks, as it's split and passed on line by line */
+#define LINE_IO_LENGTH (DEFAULT_IO_LENGTH * 16)
 
 
 /*
@@ -892,40 +894,51 @@ static gboolean spawn_read_cb(GIOChannel *channel, GIOCondition condition, gpoin
 
 		if (line_buffer)
 		{
-			gsize n = line_buffer->len;
-
-			while ((status = g_io_channel_read_chars(channel, line_buffer->str + n,
-				DEFAULT_IO_LENGTH, &chars_read, NULL)) == G_IO_STATUS_NORMAL)
+			do
 			{
-				g_string_set_size(line_buffer, n + chars_read);
+				gsize len = line_buffer->len;
+				/* the rest of the previous data has no line ends, except maybe a final '\r' */
+				gsize n = len ? len - 1 : 0;
+				gsize start = 0;
+
+				g_string_set_size(line_buffer, len + LINE_IO_LENGTH);
+				status = g_io_channel_read_chars(channel, line_buffer->str + len,
+					LINE_IO_LENGTH, &chars_read, NULL);
+				g_string_set_size(line_buffer, len + (status == G_IO_STATUS_NORMAL ? chars_read : 0));
 
+				if (status != G_IO_STATUS_NORMAL)
+					break;
+
+				/* lines are passed on from where they start, the buffer is only compacted
+				 * once per read */
 				while (n < line_buffer->len)
 				{
-					gsize line_len = 0;
+					gsize line_end;
 
-					if (n == sc->max_length)
-						line_len = n;
-					else if (strchr("\n", line_buffer->str[n]))  /* '\n' or '\0' */
-						line_len = n + 1;
-					else if (n < line_buffer->len - 1 && line_buffer->str[n] == '\r')
-						line_len = n + 1 + (line_buffer->str[n + 1] == '\n');
+					/* stops at '\r', '\n' or '\0', which includes the end of the buffer */
+					n += strcspn(line_buffer->str + n, "\r\n");
 
-					if (!line_len)
-						n++;
+					if (n - start >= sc->max_length)
+						line_end = start + sc->max_length;
+					else if (n == line_buffer->len)
+						break;
+					else if (line_buffer->str[n] != '\r')  /* '\n' or '\0' */
+						line_end = n + 1;
+					else if (n < line_buffer->len - 1)
+						line_end = n + 1 + (line_buffer->str[n + 1] == '\n');
 					else
-					{
-						g_string_append_len(buffer, line_buffer->str, line_len);
-						g_string_erase(line_buffer, 0, line_len);
-						/* input only, failures are reported separately below */
-						sc->cb.read(buffer, input_cond, sc->cb_data);
-						g_string_truncate(buffer, 0);
-						n = 0;
-					}
+						break;  /* wait for a possible '\n' */
+
+					g_string_append_len(buffer, line_buffer->str + start, line_end - start);
+					/* input only, failures are reported separately below */
+					sc->cb.read(buffer, input_cond, sc->cb_data);
+					g_string_truncate(buffer, 0);
+					start = n = line_end;
 				}
 
-				if (!failure_cond)
-					break;
-			}
+				if (start)
+					g_string_erase(line_buffer, 0, start);
+			} while (failure_cond);
 		}
 		else
 		{
@@ -1169,7 +1182,7 @@ gboolean spawn_with_callbacks(const gchar *working_directory, const gchar *comma
 				if (line_buffered)
 				{
 					sc->line_buffer = g_string_sized_new(sc->max_length +
-						DEFAULT_IO_LENGTH);
+						LINE_IO_LENGTH);
 				}
 			}
 
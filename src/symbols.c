@@ -117,6 +117,18 @@ static struct
 }
 symbol_menu;
 
+/* the tags files of a filetype, read by global_tags_pool */
+typedef struct GlobalTagsJob
+{
+	GeanyFiletype *ft;
+	GPtrArray *file_tags;	/* the tags read from each of ft->priv->tag_files, or NULL */
+}
+GlobalTagsJob;
+
+static GThreadPool *global_tags_pool = NULL;
+/* the jobs pushed to global_tags_pool which on_global_tags_read() didn't get yet */
+static GSList *global_tags_jobs = NULL;
+
 static void load_user_tags(GeanyFiletypeID ft_id);
 
 /* get the tags_ignore list, exported by tagmanager's options.c */
@@ -423,6 +435,19 @@ tag_list_add_groups(GtkTreeStore *tree_store, ...)
 
 	g_return_if_fail(top_level_iter_names);
 
+	/* collect all the titles first, as the store may be sorted and the sort
+	 * function needs them to order the top level rows */
+	va_start(args, tree_store);
+	for (; iter = va_arg(args, GtkTreeIter*), iter != NULL;)
+	{
+		gchar *title = va_arg(args, gchar*);
+
+		va_arg(args, guint);
+		g_assert(title != NULL);
+		g_ptr_array_add(top_level_iter_names, title);
+	}
+	va_end(args);
+
 	va_start(args, tree_store);
 	for (; iter = va_arg(args, GtkTreeIter*), iter != NULL;)
 	{
@@ -433,15 +458,13 @@ tag_list_add_groups(GtkTreeStore *tree_store, ...)
 		if (icon_id < N_ICONS)
 			icon = symbols_icons[icon_id].pixbuf;
 
-		g_assert(title != NULL);
-		g_ptr_array_add(top_level_iter_names, title);
-
 		if (!find_toplevel_iter(tree_store, iter, title))
-			gtk_tree_store_append(tree_store, iter, NULL);
-
-		if (icon)
+		{
+			gtk_tree_store_insert_with_values(tree_store, iter, NULL, -1,
+				SYMBOLS_COLUMN_ICON, icon, SYMBOLS_COLUMN_NAME, title, -1);
+		}
+		else if (icon)
 			gtk_tree_store_set(tree_store, iter, SYMBOLS_COLUMN_ICON, icon, -1);
-		gtk_tree_store_set(tree_store, iter, SYMBOLS_COLUMN_NAME, title, -1);
 	}
 	va_end(args);
 }
@@ -1146,6 +1169,19 @@ static void parents_table_tree_value_free(gpointer data)
 }
 
 
+/* a row to update with a new tag once the tree walk is done */
+typedef struct ChangedRow
+{
+	GtkTreeIter iter;
+	TMTag *tag;
+	gboolean has_parent;
+} ChangedRow;
+
+/* more new tags than this are inserted unsorted and the tree sorted afterwards, as
+ * each insertion into a sorted store walks the row's siblings */
+#define SYMBOLS_MAX_SORTED_INSERTS 16
+
+
 /* adds a new element in the parent table if its key is known. */
 static void update_parents_table(GHashTable *table, const TMTag *tag, const gchar *parent_name,
 		const GtkTreeIter *iter)
@@ -1301,16 +1337,26 @@ static void tags_table_value_free(gpointer data)
  *   on each tag;
  * - the other holding "tag-name":row references for tags having children, used to
  *   lookup for a parent in both passes, avoiding tree traversal.
+ *
+ * If @a sorted is TRUE the store is kept sorted, so that only the changed rows are
+ * moved into place instead of sorting the whole tree again afterwards.  Row changes
+ * are applied after the first pass as moving rows would break the walk.  Inserting
+ * many rows into a sorted store is slow, so sorting is disabled when there are more
+ * than SYMBOLS_MAX_SORTED_INSERTS new tags.
+ *
+ * Returns: Whether the store is still sorted.
  */
-static void update_tree_tags(GeanyDocument *doc, GList **tags)
+static gboolean update_tree_tags(GeanyDocument *doc, GList **tags, gboolean sorted)
 {
 	GtkTreeStore *store = doc->priv->tag_store;
 	GtkTreeModel *model = GTK_TREE_MODEL(store);
 	GHashTable *parents_table;
 	GHashTable *tags_table;
+	GArray *changed_rows;
 	GtkTreeIter iter;
 	gboolean cont;
 	GList *item;
+	guint i;
 
 	/* Build hash tables holding tags and parents */
 	/* parent table is GHashTable<tag_name, GTree<line_num, GtkTreeIter>> */
@@ -1329,6 +1375,7 @@ static void update_tree_tags(GeanyDocument *doc, GList **tags)
 		if (name)
 			g_hash_table_insert(parents_table, (gpointer) name, NULL);
 	}
+	changed_rows = g_array_new(FALSE, FALSE, sizeof(ChangedRow));
 
 	/* First pass, update existing rows or delete them.
 	 * It is OK to delete them since we walk top down so we would remove
@@ -1361,19 +1408,9 @@ static void update_tree_tags(GeanyDocument *doc, GList **tags)
 
 				if (!tm_tags_equal(tag, found))
 				{
-					const gchar *name;
-					gchar *tooltip;
-
-					/* only update fields that (can) have changed (name that holds line
-					 * number, tooltip, and the tag itself) */
-					name = get_symbol_name(doc, found, parent_name != NULL);
-					tooltip = get_symbol_tooltip(doc, found);
-					gtk_tree_store_set(store, &iter,
-							SYMBOLS_COLUMN_NAME, name,
-							SYMBOLS_COLUMN_TOOLTIP, tooltip,
-							SYMBOLS_COLUMN_TAG, found,
-							-1);
-					g_free(tooltip);
+					ChangedRow row = {iter, found, parent_name != NULL};
+
+					g_array_append_val(changed_rows, row);
 				}
 
 				update_parents_table(parents_table, found, parent_name, &iter);
@@ -1389,6 +1426,33 @@ static void update_tree_tags(GeanyDocument *doc, GList **tags)
 		}
 	}
 
+	/* store iters persist, so the rows can be updated now that the walk is done */
+	for (i = 0; i < changed_rows->len; i++)
+	{
+		ChangedRow *row = &g_array_index(changed_rows, ChangedRow, i);
+		const gchar *name;
+		gchar *tooltip;
+
+		/* only update fields that (can) have changed (name that holds line
+		 * number, tooltip, and the tag itself) */
+		name = get_symbol_name(doc, row->tag, row->has_parent);
+		tooltip = get_symbol_tooltip(doc, row->tag);
+		gtk_tree_store_set(store, &row->iter,
+				SYMBOLS_COLUMN_NAME, name,
+				SYMBOLS_COLUMN_TOOLTIP, tooltip,
+				SYMBOLS_COLUMN_TAG, row->tag,
+				-1);
+		g_free(tooltip);
+	}
+	g_array_free(changed_rows, TRUE);
+
+	if (sorted && g_list_nth(*tags, SYMBOLS_MAX_SORTED_INSERTS) != NULL)
+	{
+		gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(store),
+			GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID, 0);
+		sorted = FALSE;
+	}
+
 	/* Second pass, now we have a tree cleaned up from invalid rows,
 	 * we simply add new ones */
 	foreach_list (item, *tags)
@@ -1444,6 +1508,8 @@ static void update_tree_tags(GeanyDocument *doc, GList **tags)
 
 	g_hash_table_destroy(parents_table);
 	g_hash_table_destroy(tags_table);
+
+	return sorted;
 }
 
 
@@ -1543,14 +1609,28 @@ static void sort_tree(GtkTreeStore *store, gboolean sort_by_name)
 {
 	gtk_tree_sortable_set_sort_func(GTK_TREE_SORTABLE(store), SYMBOLS_COLUMN_NAME, tree_sort_func,
 		GINT_TO_POINTER(sort_by_name), NULL);
+	g_object_set_data(G_OBJECT(store), "sort_by_name", GINT_TO_POINTER(sort_by_name));
 
 	gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(store), SYMBOLS_COLUMN_NAME, GTK_SORT_ASCENDING);
 }
 
 
+/* whether the store is currently sorted with sort_tree(store, sort_by_name) */
+static gboolean tree_is_sorted(GtkTreeStore *store, gboolean sort_by_name)
+{
+	gint sort_column_id;
+	GtkSortType order;
+
+	return gtk_tree_sortable_get_sort_column_id(GTK_TREE_SORTABLE(store), &sort_column_id, &order) &&
+		sort_column_id == SYMBOLS_COLUMN_NAME &&
+		GPOINTER_TO_INT(g_object_get_data(G_OBJECT(store), "sort_by_name")) == sort_by_name;
+}
+
+
 gboolean symbols_recreate_tag_list(GeanyDocument *doc, gint sort_mode)
 {
 	GList *tags;
+	gboolean sorted;
 
 	g_return_val_if_fail(DOC_VALID(doc), FALSE);
 
@@ -1558,24 +1638,28 @@ gboolean symbols_recreate_tag_list(GeanyDocument *doc, gint sort_mode)
 	if (tags == NULL)
 		return FALSE;
 
+	if (sort_mode == SYMBOLS_SORT_USE_PREVIOUS)
+		sort_mode = doc->priv->symbol_list_sort_mode;
+
 	/* FIXME: Not sure why we detached the model here? */
 
-	/* disable sorting during update because the code doesn't support correctly
-	 * models that are currently being built */
-	gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(doc->priv->tag_store), GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID, 0);
+	/* if the tree is already sorted the same way, keep it sorted so only the rows
+	 * that changed get moved; otherwise disable sorting during update and sort the
+	 * whole tree once afterwards */
+	sorted = tree_is_sorted(doc->priv->tag_store, sort_mode == SYMBOLS_SORT_BY_NAME);
+	if (! sorted)
+		gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(doc->priv->tag_store), GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID, 0);
 
 	/* add grandparent type iters */
 	add_top_level_items(doc);
 
-	update_tree_tags(doc, &tags);
+	sorted = update_tree_tags(doc, &tags, sorted);
 	g_list_free(tags);
 
 	hide_empty_rows(doc->priv->tag_store);
 
-	if (sort_mode == SYMBOLS_SORT_USE_PREVIOUS)
-		sort_mode = doc->priv->symbol_list_sort_mode;
-
-	sort_tree(doc->priv->tag_store, sort_mode == SYMBOLS_SORT_BY_NAME);
+	if (! sorted)
+		sort_tree(doc->priv->tag_store, sort_mode == SYMBOLS_SORT_BY_NAME);
 	doc->priv->symbol_list_sort_mode = sort_mode;
 
 	return TRUE;
@@ -1620,6 +1704,7 @@ int symbols_generate_global_tags(int argc, char **argv, gboolean want_preprocess
 		const char *tags_file = argv[1];
 		char *utf8_fname;
 		GeanyFiletype *ft;
+		GTimer *timer;
 
 		utf8_fname = utils_get_utf8_from_locale(tags_file);
 		ft = detect_global_tags_filetype(utf8_fname);
@@ -1647,16 +1732,21 @@ int symbols_generate_global_tags(int argc, char **argv, gboolean want_preprocess
 
 		geany_debug("Generating %s tags file.", ft->name);
 		tm_get_workspace();
+		timer = g_timer_new();
 		status = tm_workspace_create_global_tags(command, (const char **) (argv + 2),
 												 argc - 2, tags_file, ft->lang);
+		g_timer_stop(timer);
 		g_free(command);
 		symbols_finalize(); /* free c_tags_ignore data */
 		if (! status)
 		{
+			g_timer_destroy(timer);
 			g_printerr(_("Failed to create tags file, perhaps because no symbols "
 				"were found.\n"));
 			return 1;
 		}
+		g_print(_("Created %s in %.2f seconds.\n"), tags_file, g_timer_elapsed(timer, NULL));
+		g_timer_destroy(timer);
 	}
 	else
 	{
@@ -1758,11 +1848,70 @@ static void init_user_tags(void)
 }
 
 
+/* Adds the tags read by read_global_tags() in the main thread and updates the highlighting of
+ * the documents using them. */
+static gboolean on_global_tags_read(gpointer data)
+{
+	GlobalTagsJob *job = data;
+	GeanyFiletype *ft = job->ft;
+	const GSList *node;
+	guint i = 0;
+
+	foreach_slist(node, ft->priv->tag_files)
+	{
+		GPtrArray *file_tags = g_ptr_array_index(job->file_tags, i++);
+
+		if (file_tags)
+		{
+			gsize old_tag_count = get_tag_count();
+
+			tm_workspace_add_global_tags(file_tags);
+			geany_debug("Loaded %s (%s), %u symbol(s).", (const gchar *) node->data, ft->name,
+				(guint) (get_tag_count() - old_tag_count));
+		}
+	}
+	global_tags_jobs = g_slist_remove(global_tags_jobs, job);
+	g_ptr_array_free(job->file_tags, TRUE);
+	g_slice_free(GlobalTagsJob, job);
+
+	/* global typenames are highlighted as type keywords */
+	foreach_document(i)
+	{
+		GeanyDocument *doc = documents[i];
+
+		if (tm_tag_langs_compatible(doc->file_type->lang, ft->lang))
+		{
+			highlighting_set_styles(doc->editor->sci, doc->file_type);
+			editor_set_indentation_guides(doc->editor);
+		}
+	}
+
+	ui_set_statusbar(FALSE, _("Loaded %s symbols."), filetypes_get_display_name(ft));
+	return FALSE;
+}
+
+
+/* Reads the tags files of a GlobalTagsJob, called in a global_tags_pool thread */
+static void read_global_tags(gpointer data, gpointer user_data)
+{
+	GlobalTagsJob *job = data;
+	const GSList *node;
+
+	foreach_slist(node, job->ft->priv->tag_files)
+	{
+		const gchar *fname = node->data;
+
+		g_ptr_array_add(job->file_tags, tm_workspace_read_global_tags(fname, job->ft->lang));
+	}
+	g_idle_add(on_global_tags_read, job);
+}
+
+
 static void load_user_tags(GeanyFiletypeID ft_id)
 {
 	static guchar *tags_loaded = NULL;
 	static gboolean init_tags = FALSE;
-	const GSList *node;
+	GlobalTagsJob *job;
 	GeanyFiletype *ft = filetypes[ft_id];
 
 	g_return_if_fail(ft_id > 0);
@@ -1779,12 +1928,19 @@ static void load_user_tags(GeanyFiletypeID ft_id)
 		init_tags = TRUE;
 	}
 
-	for (node = ft->priv->tag_files; node != NULL; node = g_slist_next(node))
-	{
-		const gchar *fname = node->data;
+	if (ft->priv->tag_files == NULL)
+		return;
 
-		symbols_load_global_tags(fname, ft);
-	}
+	/* reading and sorting big tags files takes a while, so do it in the background */
+	if (! global_tags_pool)
+		global_tags_pool = g_thread_pool_new(read_global_tags, NULL, 1, FALSE, NULL);
+	job = g_slice_new(GlobalTagsJob);
+	job->ft = ft;
+	job->file_tags = g_ptr_array_new();
+	global_tags_jobs = g_slist_prepend(global_tags_jobs, job);
+	g_thread_pool_push(global_tags_pool, job, NULL);
+
+	ui_set_statusbar(FALSE, _("Loading %s symbols..."), filetypes_get_display_name(ft));
 }
 
 
@@ -1990,44 +2146,86 @@ static gint compare_tags_by_name_line(gconstpointer ptr1, gconstpointer ptr2)
 }
 
 
-static TMTag *find_best_goto_tag(GeanyDocument *doc, GPtrArray *tags)
+/* compares argument lists ignoring whitespace, as declarations and definitions are often
+ * formatted differently */
+static gboolean arglists_equal(const gchar *a, const gchar *b)
 {
-	TMTag *tag;
-	guint i;
+	if (a == NULL || b == NULL)
+		return a == b;
 
-	/* first check if we have a tag in the current file */
-	foreach_ptr_array(tag, i, tags)
+	while (TRUE)
 	{
-		if (g_strcmp0(doc->real_path, tag->file->file_name) == 0)
-			return tag;
+		while (g_ascii_isspace(*a))
+			a++;
+		while (g_ascii_isspace(*b))
+			b++;
+		if (*a != *b)
+			return FALSE;
+		if (*a == '\0')
+			return TRUE;
+		a++;
+		b++;
 	}
+}
 
-	/* next check if we have a tag for some of the open documents */
-	foreach_ptr_array(tag, i, tags)
-	{
-		guint j;
 
-		foreach_document(j)
-		{
-			if (g_strcmp0(documents[j]->real_path, tag->file->file_name) == 0)
-				return tag;
-		}
+#define GOTO_RANK_COUNTERPART 4
+
+/* Ranks how likely @a tag is the one to go to, higher is better and 0 means no preference.
+ * The counterpart of @a current_tag (same scope and argument list) comes first, then tags
+ * in the current file, in open documents and in the current document's directory. */
+static guint get_goto_tag_rank(const TMTag *tag, const TMTag *current_tag, GeanyDocument *doc,
+		const gchar *dir)
+{
+	guint rank = 0;
+
+	if (g_strcmp0(doc->real_path, tag->file->file_name) == 0)
+		rank = 3;
+	else if (document_find_by_real_path(tag->file->file_name) != NULL)
+		rank = 2;
+	else if (dir != NULL && g_str_has_prefix(tag->file->file_name, dir))
+		rank = 1;
+
+	if (current_tag != NULL && g_strcmp0(current_tag->scope, tag->scope) == 0 &&
+		arglists_equal(current_tag->arglist, tag->arglist))
+	{
+		rank += GOTO_RANK_COUNTERPART;
 	}
+	return rank;
+}
+
+
+/* @a unique_counterpart is set to whether the returned tag is the only counterpart of
+ * @a current_tag, so it can be used without asking */
+static TMTag *find_best_goto_tag(GeanyDocument *doc, GPtrArray *tags, const TMTag *current_tag,
+		gboolean *unique_counterpart)
+{
+	TMTag *tag, *best_tag = NULL;
+	guint best_rank = 0;
+	guint counterparts = 0;
+	gchar *dir = NULL;
+	guint i;
 
-	/* next check if we have a tag for a file inside the current document's directory */
+	if (doc->real_path != NULL)
+		dir = g_path_get_dirname(doc->real_path);
+
+	/* a single pass, keeping the first of the tags with the highest rank */
 	foreach_ptr_array(tag, i, tags)
 	{
-		gchar *dir = g_path_get_dirname(doc->real_path);
+		guint rank = get_goto_tag_rank(tag, current_tag, doc, dir);
 
-		if (g_str_has_prefix(tag->file->file_name, dir))
+		if (rank >= GOTO_RANK_COUNTERPART)
+			counterparts++;
+		if (rank > best_rank)
 		{
-			g_free(dir);
-			return tag;
+			best_tag = tag;
+			best_rank = rank;
 		}
-		g_free(dir);
 	}
 
-	return NULL;
+	g_free(dir);
+	*unique_counterpart = counterparts == 1;
+	return best_tag;
 }
 
 
@@ -2069,8 +2267,9 @@ static gboolean goto_tag(const gchar *name, gboolean definition)
 	TMTag *tmtag, *current_tag = NULL;
 	GeanyDocument *old_doc = document_get_current();
 	gboolean found = FALSE;
-	const GPtrArray *all_tags;
-	GPtrArray *tags, *filtered_tags;
+	gboolean unique_counterpart = FALSE;
+	GPtrArray *all_tags, *tags, *filtered_tags;
+	TMTag *best_tag = NULL;
 	guint i;
 	guint current_line = sci_get_current_line(old_doc->editor->sci) + 1;
 
@@ -2087,6 +2286,7 @@ static gboolean goto_tag(const gchar *name, gboolean definition)
 				current_tag = tmtag;
 		}
 	}
+	g_ptr_array_free(all_tags, TRUE);
 
 	if (current_tag)
 		/* swap definition/declaration search */
@@ -2102,11 +2302,17 @@ static gboolean goto_tag(const gchar *name, gboolean definition)
 	g_ptr_array_free(tags, TRUE);
 	tags = filtered_tags;
 
-	if (tags->len == 1)
+	if (tags->len > 1)
+	{
+		g_ptr_array_sort(tags, compare_tags_by_name_line);
+		best_tag = find_best_goto_tag(old_doc, tags, current_tag, &unique_counterpart);
+	}
+
+	if (tags->len == 1 || unique_counterpart)
 	{
 		GeanyDocument *new_doc;
 
-		tmtag = tags->pdata[0];
+		tmtag = unique_counterpart ? best_tag : tags->pdata[0];
 		new_doc = document_find_by_real_path(tmtag->file->file_name);
 
 		if (!new_doc)
@@ -2118,10 +2324,7 @@ static gboolean goto_tag(const gchar *name, gboolean definition)
 	else if (tags->len > 1)
 	{
 		GPtrArray *tag_list;
-		TMTag *tag, *best_tag;
-
-		g_ptr_array_sort(tags, compare_tags_by_name_line);
-		best_tag = find_best_goto_tag(old_doc, tags);
+		TMTag *tag;
 
 		tag_list = g_ptr_array_new();
 		if (best_tag)
@@ -2338,7 +2541,7 @@ static gint get_current_tag_name(GeanyDocument *doc, gchar **tagname, TMTagType
 	if (parent >= 0 && doc->tm_file != NULL && doc->tm_file->tags_array != NULL &&
 		(! doc->changed || editor_prefs.autocompletion_update_freq > 0))
 	{
-		const TMTag *tag = tm_get_current_tag(doc->tm_file->tags_array, parent + 1, tag_types);
+		const TMTag *tag = tm_source_file_get_current_tag(doc->tm_file, parent + 1, tag_types);
 
 		if (tag)
 		{
@@ -2640,12 +2843,54 @@ void symbols_init(void)
 }
 
 
+/* Writes the tag manager statistics to the debug messages */
+void symbols_log_statistics(void)
+{
+	gchar *stats;
+
+	if (app->tm_workspace == NULL)
+		return;
+
+	stats = tm_workspace_get_statistics();
+	geany_debug("Symbol statistics: %s", stats);
+	g_free(stats);
+}
+
+
 void symbols_finalize(void)
 {
 	guint i;
 
 	g_strfreev(c_tags_ignore);
 
+	if (global_tags_pool)
+	{
+		GSList *node;
+
+		/* wait for a running job, queued ones are dropped */
+		g_thread_pool_free(global_tags_pool, TRUE, TRUE);
+		global_tags_pool = NULL;
+
+		/* free the dropped jobs and the ones on_global_tags_read() didn't get */
+		foreach_slist(node, global_tags_jobs)
+		{
+			GlobalTagsJob *job = node->data;
+
+			g_idle_remove_by_data(job);
+			for (i = 0; i < job->file_tags->len; i++)
+			{
+				GPtrArray *file_tags = g_ptr_array_index(job->file_tags, i);
+
+				if (file_tags)
+					tm_tags_array_free(file_tags, TRUE);
+			}
+			g_ptr_array_free(job->file_tags, TRUE);
+			g_slice_free(GlobalTagsJob, job);
+		}
+		g_slist_free(global_tags_jobs);
+		global_tags_jobs = NULL;
+	}
+
 	for (i = 0; i < G_N_ELEMENTS(symbols_icons); i++)
 	{
 		if (symbols_icons[i].pixbuf)
@@ -64,6 +64,8 @@ gint symbols_get_current_function(GeanyDocument *doc, const gchar **tagname);
 
 gint symbols_get_current_scope(GeanyDocument *doc, const gchar **tagname);
 
+void symbols_log_statistics(void);
+
 #endif /* GEANY_PRIVATE */
 
 G_END_DECLS
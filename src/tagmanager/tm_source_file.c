@@ -36,8 +36,14 @@ typedef struct
 {
 	TMSourceFile public;
 	guint refcount;
+	GPtrArray *line_index; /* scope tags sorted by line, built on demand after parsing */
+	gint64 parse_time; /* duration of the last parse in microseconds */
 } TMSourceFilePriv;
 
+/* tag types kept in the line index, see tm_source_file_get_current_tag() */
+#define LINE_INDEX_TYPES (tm_tag_class_t | tm_tag_enum_t | tm_tag_function_t | \
+	tm_tag_method_t | tm_tag_namespace_t | tm_tag_struct_t | tm_tag_union_t)
+
 
 typedef enum {
 	TM_FILE_FORMAT_TAGMANAGER,
@@ -722,6 +728,8 @@ TMSourceFile *tm_source_file_new(const char *file_name, const char *name)
 		return NULL;
 	}
 	priv->refcount = 1;
+	priv->line_index = NULL;
+	priv->parse_time = 0;
 	return &priv->public;
 }
 
@@ -736,6 +744,18 @@ static TMSourceFile *tm_source_file_dup(TMSourceFile *source_file)
 	return source_file;
 }
 
+/* Drops the line index, it holds pointers to the tags which are about to change */
+static void clear_line_index(TMSourceFile *source_file)
+{
+	TMSourceFilePriv *priv = (TMSourceFilePriv *) source_file;
+
+	if (priv->line_index)
+	{
+		g_ptr_array_free(priv->line_index, TRUE);
+		priv->line_index = NULL;
+	}
+}
+
 /* Destroys the contents of the source file. Note that the tags are owned by the
  source file and are also destroyed when the source file is destroyed. If pointers
  to these tags are used elsewhere, then those tag arrays should be rebuilt.
@@ -747,6 +767,7 @@ static void tm_source_file_destroy(TMSourceFile *source_file)
 #endif
 
 	g_free(source_file->file_name);
+	clear_line_index(source_file);
 	tm_tags_array_free(source_file->tags_array, TRUE);
 	source_file->tags_array = NULL;
 }
@@ -779,6 +800,59 @@ GType tm_source_file_get_type(void);
 
 G_DEFINE_BOXED_TYPE(TMSourceFile, tm_source_file, tm_source_file_dup, tm_source_file_free);
 
+static guint tag_signature_hash(gconstpointer key)
+{
+	const TMTag *tag = key;
+	const gchar *name = FALLBACK(tag->name, "");
+
+	return g_str_hash(name) ^ tag->line;
+}
+
+static gboolean tag_signature_equal(gconstpointer a, gconstpointer b)
+{
+	return tm_tags_equal(a, b);
+}
+
+/* Replaces the newly parsed tags which are identical to a tag of the previous parse with
+ the old tag, so that unchanged symbols keep their TMTag pointers across reparses.
+ Takes over the references held by old_tags. */
+static void reuse_unchanged_tags(TMSourceFile *source_file, GPtrArray *old_tags)
+{
+	GPtrArray *tags_array = source_file->tags_array;
+	GHashTable *old_table;
+	guint i;
+
+	if (old_tags->len == 0 || tags_array->len == 0)
+	{
+		tm_tags_array_free(old_tags, TRUE);
+		return;
+	}
+
+	old_table = g_hash_table_new(tag_signature_hash, tag_signature_equal);
+	for (i = 0; i < old_tags->len; i++)
+	{
+		/* keep the first of identical tags, each old tag is reused at most once */
+		if (!g_hash_table_contains(old_table, old_tags->pdata[i]))
+			g_hash_table_add(old_table, old_tags->pdata[i]);
+	}
+
+	for (i = 0; i < tags_array->len; i++)
+	{
+		TMTag *tag = tags_array->pdata[i];
+		TMTag *old_tag = g_hash_table_lookup(old_table, tag);
+
+		if (old_tag)
+		{
+			g_hash_table_remove(old_table, old_tag);
+			tags_array->pdata[i] = tm_tag_ref(old_tag);
+			tm_tag_unref(tag);
+		}
+	}
+
+	g_hash_table_destroy(old_table);
+	tm_tags_array_free(old_tags, TRUE);
+}
+
 /* Parses the text-buffer or source file and regenarates the tags.
  @param source_file The source file to parse
  @param text_buf The text buffer to parse
@@ -794,12 +868,17 @@ gboolean tm_source_file_parse(TMSourceFile *source_file, guchar* text_buf, gsize
 	gboolean retry = TRUE;
 	gboolean parse_file = FALSE;
 	gboolean free_buf = FALSE;
+	GPtrArray *old_tags;
+	gint64 start_time;
+	guint i;
 
 	if ((NULL == source_file) || (NULL == source_file->file_name))
 	{
 		g_warning("Attempt to parse NULL file");
 		return FALSE;
 	}
+
+	clear_line_index(source_file);
 	
 	if (source_file->lang == TM_PARSER_NONE)
 	{
@@ -836,16 +915,116 @@ gboolean tm_source_file_parse(TMSourceFile *source_file, guchar* text_buf, gsize
 		return TRUE;
 	}
 
-	tm_tags_array_free(source_file->tags_array, FALSE);
+	/* keep the previous tags until the parse is done so that unchanged ones can be reused */
+	old_tags = g_ptr_array_sized_new(source_file->tags_array->len);
+	for (i = 0; i < source_file->tags_array->len; i++)
+		g_ptr_array_add(old_tags, source_file->tags_array->pdata[i]);
+	g_ptr_array_set_size(source_file->tags_array, 0);
 
+	start_time = g_get_monotonic_time();
 	tm_ctags_parse(parse_file ? NULL : text_buf, buf_size, file_name,
 		source_file->lang, ctags_new_tag, ctags_pass_start, source_file);
+	((TMSourceFilePriv *) source_file)->parse_time = g_get_monotonic_time() - start_time;
+
+	reuse_unchanged_tags(source_file, old_tags);
 
 	if (free_buf)
 		g_free(text_buf);
 	return !retry;
 }
 
+/* Gets how long the last parse of the source file took.
+ @param source_file The source file.
+ @return The duration in microseconds.
+*/
+gint64 tm_source_file_get_parse_time(TMSourceFile *source_file)
+{
+	g_return_val_if_fail(source_file != NULL, 0);
+
+	return ((TMSourceFilePriv *) source_file)->parse_time;
+}
+
+static gint compare_tag_lines(gconstpointer a, gconstpointer b)
+{
+	const TMTag *t1 = *((const TMTag **) a);
+	const TMTag *t2 = *((const TMTag **) b);
+
+	if (t1->line == t2->line)
+		return 0;
+	return t1->line < t2->line ? -1 : 1;
+}
+
+/* Returns the tag which "owns" the given line, like tm_get_current_tag() but using a line
+ index of the file's scope tags built once per parse, so that the lookup is a binary search
+ instead of a scan of all the file's tags.
+ @param source_file The source file the line is in.
+ @param line The line to look for.
+ @param tag_types The tag types to include in the match.
+ @return The closest tag of one of @a tag_types starting on or before @a line, or NULL.
+*/
+const TMTag *tm_source_file_get_current_tag(TMSourceFile *source_file, gulong line,
+	TMTagType tag_types)
+{
+	TMSourceFilePriv *priv = (TMSourceFilePriv *) source_file;
+	GPtrArray *index;
+	guint low, high;
+
+	g_return_val_if_fail(source_file != NULL, NULL);
+
+	if (tag_types & ~LINE_INDEX_TYPES)
+		return tm_get_current_tag(source_file->tags_array, line, tag_types);
+
+	if (!priv->line_index)
+	{
+		guint i;
+
+		priv->line_index = g_ptr_array_new();
+		for (i = 0; source_file->tags_array && i < source_file->tags_array->len; i++)
+		{
+			TMTag *tag = source_file->tags_array->pdata[i];
+
+			/* tags without a line can't own one, tm_get_current_tag() skips them too */
+			if ((tag->type & LINE_INDEX_TYPES) && tag->line > 0)
+				g_ptr_array_add(priv->line_index, tag);
+		}
+		g_ptr_array_sort(priv->line_index, compare_tag_lines);
+	}
+	index = priv->line_index;
+
+	/* find the first tag after the line */
+	low = 0;
+	high = index->len;
+	while (low < high)
+	{
+		guint mid = low + (high - low) / 2;
+
+		if (TM_TAG(index->pdata[mid])->line <= line)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	/* and go back to the closest one of the requested types */
+	while (low > 0)
+	{
+		TMTag *tag = index->pdata[--low];
+
+		if (tag->type & tag_types)
+		{
+			/* prefer the first matching tag of the line, as tm_get_current_tag() does */
+			while (low > 0 && TM_TAG(index->pdata[low - 1])->line == tag->line)
+			{
+				TMTag *prev = index->pdata[--low];
+
+				if (prev->type & tag_types)
+					tag = prev;
+			}
+			return tag;
+		}
+	}
+	return NULL;
+}
+
 /* Gets the name associated with the language index.
  @param lang The language index.
  @return The language name, or NULL.
@@ -61,6 +61,11 @@ GPtrArray *tm_source_file_read_tags_file(const gchar *tags_file, TMParserType mo
 
 gboolean tm_source_file_write_tags_file(const gchar *tags_file, GPtrArray *tags_array);
 
+const struct TMTag *tm_source_file_get_current_tag(TMSourceFile *source_file, gulong line,
+	TMTagType tag_types);
+
+gint64 tm_source_file_get_parse_time(TMSourceFile *source_file);
+
 #endif /* GEANY_PRIVATE */
 
 G_END_DECLS
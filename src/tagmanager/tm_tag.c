@@ -80,8 +80,20 @@ typedef struct
 	gboolean partial;
 	const GPtrArray *tags_array;
 	gboolean first;
+	GCompareDataFunc compare;	/* the comparison function for sort_attrs and partial */
+	gsize name_len;				/* length of the searched name for partial comparisons */
 } TMSortOptions;
 
+/* arrays with at least this many tags are sorted by name using cached name prefixes */
+#define NAME_KEY_SORT_MIN 1024
+
+/* a tag with the first bytes of its name, for sorting without reading the name itself */
+typedef struct
+{
+	guint64 name_key;
+	TMTag *tag;
+} TMSortItem;
+
 /** Gets the GType for a TMTag.
  *
  * @return TMTag type
@@ -154,6 +166,49 @@ TMTag *tm_tag_ref(TMTag *tag)
 	return tag;
 }
 
+static gint compare_names(const TMTag *t1, const TMTag *t2)
+{
+	const gchar *name1 = FALLBACK(t1->name, "");
+	const gchar *name2 = FALLBACK(t2->name, "");
+
+	/* most names already differ in the first character */
+	if (*name1 != *name2)
+		return (guchar) *name1 - (guchar) *name2;
+	return strcmp(name1, name2);
+}
+
+
+/* Comparison function for the sort options without any attributes */
+static gint tm_tag_compare_name(gconstpointer ptr1, gconstpointer ptr2, gpointer user_data)
+{
+	TMTag *t1 = *((TMTag **) ptr1);
+	TMTag *t2 = *((TMTag **) ptr2);
+
+	if ((NULL == t1) || (NULL == t2))
+	{
+		g_warning("Found NULL tag");
+		return t2 - t1;
+	}
+	return compare_names(t1, t2);
+}
+
+
+/* Comparison function for partial matches of a searched name, which is the first tag */
+static gint tm_tag_compare_name_partial(gconstpointer ptr1, gconstpointer ptr2, gpointer user_data)
+{
+	TMTag *t1 = *((TMTag **) ptr1);
+	TMTag *t2 = *((TMTag **) ptr2);
+	TMSortOptions *sort_options = user_data;
+
+	if ((NULL == t1) || (NULL == t2))
+	{
+		g_warning("Found NULL tag");
+		return t2 - t1;
+	}
+	return strncmp(FALLBACK(t1->name, ""), FALLBACK(t2->name, ""), sort_options->name_len);
+}
+
+
 /*
  Inbuilt tag comparison function.
 */
@@ -173,9 +228,9 @@ static gint tm_tag_compare(gconstpointer ptr1, gconstpointer ptr2, gpointer user
 	if (NULL == sort_options->sort_attrs)
 	{
 		if (sort_options->partial)
-			return strncmp(FALLBACK(t1->name, ""), FALLBACK(t2->name, ""), strlen(FALLBACK(t1->name, "")));
+			return strncmp(FALLBACK(t1->name, ""), FALLBACK(t2->name, ""), sort_options->name_len);
 		else
-			return strcmp(FALLBACK(t1->name, ""), FALLBACK(t2->name, ""));
+			return compare_names(t1, t2);
 	}
 
 	for (sort_attr = sort_options->sort_attrs; returnval == 0 && *sort_attr != tm_tag_attr_none_t; ++ sort_attr)
@@ -184,9 +239,9 @@ static gint tm_tag_compare(gconstpointer ptr1, gconstpointer ptr2, gpointer user
 		{
 			case tm_tag_attr_name_t:
 				if (sort_options->partial)
-					returnval = strncmp(FALLBACK(t1->name, ""), FALLBACK(t2->name, ""), strlen(FALLBACK(t1->name, "")));
+					returnval = strncmp(FALLBACK(t1->name, ""), FALLBACK(t2->name, ""), sort_options->name_len);
 				else
-					returnval = strcmp(FALLBACK(t1->name, ""), FALLBACK(t2->name, ""));
+					returnval = compare_names(t1, t2);
 				break;
 			case tm_tag_attr_file_t:
 				returnval = t1->file - t2->file;
@@ -217,6 +272,87 @@ static gint tm_tag_compare(gconstpointer ptr1, gconstpointer ptr2, gpointer user
 	return returnval;
 }
 
+
+/* Sets up sort options, choosing the cheapest comparison function for them */
+static void init_sort_options(TMSortOptions *sort_options, TMTagAttrType *sort_attributes,
+	gboolean partial)
+{
+	sort_options->sort_attrs = sort_attributes;
+	sort_options->partial = partial;
+	sort_options->tags_array = NULL;
+	sort_options->first = FALSE;
+	sort_options->name_len = 0;
+
+	if (sort_attributes && sort_attributes[0] == tm_tag_attr_name_t &&
+		sort_attributes[1] == tm_tag_attr_none_t)
+	{
+		/* same as no attributes */
+		sort_options->sort_attrs = NULL;
+	}
+
+	if (sort_options->sort_attrs)
+		sort_options->compare = tm_tag_compare;
+	else if (partial)
+		sort_options->compare = tm_tag_compare_name_partial;
+	else
+		sort_options->compare = tm_tag_compare_name;
+}
+
+
+/* Returns the first 8 bytes of the tag name, packed so that comparing keys
+ * orders them like strcmp() */
+static guint64 get_name_key(const TMTag *tag)
+{
+	const guchar *name = (const guchar *) FALLBACK(tag->name, "");
+	guint64 key = 0;
+	guint i;
+
+	for (i = 0; i < sizeof(key); i++)
+	{
+		key <<= 8;
+		if (*name)
+			key |= *name++;
+	}
+	return key;
+}
+
+
+static gint compare_sort_items(gconstpointer ptr1, gconstpointer ptr2, gpointer user_data)
+{
+	const TMSortItem *item1 = ptr1;
+	const TMSortItem *item2 = ptr2;
+	TMSortOptions *sort_options = user_data;
+
+	if (item1->name_key != item2->name_key)
+		return item1->name_key < item2->name_key ? -1 : 1;
+	return sort_options->compare(&item1->tag, &item2->tag, user_data);
+}
+
+
+/* Sorts a big array by name first, comparing the cached name keys before looking
+ * at the names and other attributes, which are scattered all over memory */
+static void sort_by_name_keys(GPtrArray *tags_array, TMSortOptions *sort_options)
+{
+	TMSortItem *items = g_new(TMSortItem, tags_array->len);
+	guint i;
+
+	for (i = 0; i < tags_array->len; i++)
+	{
+		TMTag *tag = tags_array->pdata[i];
+
+		/* NULL tags are reported by the comparison function */
+		items[i].name_key = tag ? get_name_key(tag) : 0;
+		items[i].tag = tag;
+	}
+
+	g_qsort_with_data(items, tags_array->len, sizeof(TMSortItem), compare_sort_items, sort_options);
+
+	for (i = 0; i < tags_array->len; i++)
+		tags_array->pdata[i] = items[i].tag;
+	g_free(items);
+}
+
+
 gboolean tm_tags_equal(const TMTag *a, const TMTag *b)
 {
 	if (a == b)
@@ -272,11 +408,10 @@ void tm_tags_dedup(GPtrArray *tags_array, TMTagAttrType *sort_attributes, gboole
 	if (tags_array->len < 2)
 		return;
 
-	sort_options.sort_attrs = sort_attributes;
-	sort_options.partial = FALSE;
+	init_sort_options(&sort_options, sort_attributes, FALSE);
 	for (i = 1; i < tags_array->len; ++i)
 	{
-		if (0 == tm_tag_compare(&(tags_array->pdata[i - 1]), &(tags_array->pdata[i]), &sort_options))
+		if (0 == sort_options.compare(&(tags_array->pdata[i - 1]), &(tags_array->pdata[i]), &sort_options))
 		{
 			if (unref_duplicates)
 				tm_tag_unref(tags_array->pdata[i-1]);
@@ -300,30 +435,36 @@ void tm_tags_sort(GPtrArray *tags_array, TMTagAttrType *sort_attributes,
 
 	g_return_if_fail(tags_array);
 
-	sort_options.sort_attrs = sort_attributes;
-	sort_options.partial = FALSE;
-	g_ptr_array_sort_with_data(tags_array, tm_tag_compare, &sort_options);
+	init_sort_options(&sort_options, sort_attributes, FALSE);
+	if (tags_array->len >= NAME_KEY_SORT_MIN &&
+		(sort_options.sort_attrs == NULL || sort_options.sort_attrs[0] == tm_tag_attr_name_t))
+		sort_by_name_keys(tags_array, &sort_options);
+	else
+		g_ptr_array_sort_with_data(tags_array, sort_options.compare, &sort_options);
 	if (dedup)
 		tm_tags_dedup(tags_array, sort_attributes, unref_duplicates);
 }
 
-void tm_tags_remove_file_tags(TMSourceFile *source_file, GPtrArray *tags_array)
+/* Removes the tags of source_file from tags_array. file_tags are the file's tags which
+ were added to tags_array, usually source_file->tags_array. */
+void tm_tags_remove_file_tags(TMSourceFile *source_file, GPtrArray *file_tags,
+	GPtrArray *tags_array)
 {
 	guint i;
 
 	/* Now we choose between an algorithm with complexity O(tags_array->len) and
-	 * O(source_file->tags_array->len * log(tags_array->len)). The latter algorithm
+	 * O(file_tags->len * log(tags_array->len)). The latter algorithm
 	 * is better when tags_array contains many times more tags than
-	 * source_file->tags_array so instead of trying to find the removed tags
+	 * file_tags so instead of trying to find the removed tags
 	 * linearly, binary search is used. The constant 20 is more or less random
 	 * but seems to work well. It's exact value isn't so critical because it's
 	 * the extremes where the difference is the biggest: when
-	 * source_file->tags_array->len == tags_array->len (single file open) and
-	 * source_file->tags_array->len << tags_array->len (the number of tags
+	 * file_tags->len == tags_array->len (single file open) and
+	 * file_tags->len << tags_array->len (the number of tags
 	 * from the file is a small fraction of all tags).
 	 */
-	if (source_file->tags_array->len != 0 &&
-		tags_array->len / source_file->tags_array->len < 20)
+	if (file_tags->len != 0 &&
+		tags_array->len / file_tags->len < 20)
 	{
 		for (i = 0; i < tags_array->len; i++)
 		{
@@ -335,14 +476,14 @@ void tm_tags_remove_file_tags(TMSourceFile *source_file, GPtrArray *tags_array)
 	}
 	else
 	{
-		GPtrArray *to_delete = g_ptr_array_sized_new(source_file->tags_array->len);
+		GPtrArray *to_delete = g_ptr_array_sized_new(file_tags->len);
 
-		for (i = 0; i < source_file->tags_array->len; i++)
+		for (i = 0; i < file_tags->len; i++)
 		{
 			guint j;
 			guint tag_count;
 			TMTag **found;
-			TMTag *tag = source_file->tags_array->pdata[i];
+			TMTag *tag = file_tags->pdata[i];
 
 			found = tm_tags_find(tags_array, tag->name, FALSE, &tag_count);
 
@@ -418,7 +559,7 @@ static GPtrArray *merge(GPtrArray *big_array, GPtrArray *small_array,
 			/* if the value in big_array after making the big step is still smaller
 			 * than the value in small_array, we can copy all the values inbetween
 			 * into the result without making expensive string comparisons */
-			if (tm_tag_compare(&val1, &val2, sort_options) < 0)
+			if (sort_options->compare(&val1, &val2, sort_options) < 0)
 			{
 				while (i1 <= j1) 
 				{
@@ -441,7 +582,7 @@ static GPtrArray *merge(GPtrArray *big_array, GPtrArray *small_array,
 			cmpnum++;
 #endif
 			val1 = big_array->pdata[i1];
-			cmpval = tm_tag_compare(&val1, &val2, sort_options);
+			cmpval = sort_options->compare(&val1, &val2, sort_options);
 			if (cmpval < 0)
 			{
 				g_ptr_array_add(res_array, val1);
@@ -484,8 +625,7 @@ GPtrArray *tm_tags_merge(GPtrArray *big_array, GPtrArray *small_array,
 	GPtrArray *res_array;
 	TMSortOptions sort_options;
 	
-	sort_options.sort_attrs = sort_attributes;
-	sort_options.partial = FALSE;
+	init_sort_options(&sort_options, sort_attributes, FALSE);
 	res_array = merge(big_array, small_array, &sort_options, unref_duplicates);
 	return res_array;
 }
@@ -568,23 +708,23 @@ static gpointer binary_search(gpointer key, gpointer base, size_t nmemb,
 
 static gint tag_search_cmp(gconstpointer ptr1, gconstpointer ptr2, gpointer user_data)
 {
-	gint res = tm_tag_compare(ptr1, ptr2, user_data);
+	TMSortOptions *sort_options = user_data;
+	gint res = sort_options->compare(ptr1, ptr2, user_data);
 
 	if (res == 0)
 	{
-		TMSortOptions *sort_options = user_data;
 		const GPtrArray *tags_array = sort_options->tags_array;
 		TMTag **tag = (TMTag **) ptr2;
 
 		/* if previous/next (depending on sort options) tag equal, we haven't
 		 * found the first/last tag in a sequence of equal tags yet */
 		if (sort_options->first && ptr2 != &tags_array->pdata[0]) {
-			if (tm_tag_compare(ptr1, tag - 1, user_data) == 0)
+			if (sort_options->compare(ptr1, tag - 1, user_data) == 0)
 				return -1;
 		}
 		else if (!sort_options->first && ptr2 != &tags_array->pdata[tags_array->len-1])
 		{
-			if (tm_tag_compare(ptr1, tag + 1, user_data) == 0)
+			if (sort_options->compare(ptr1, tag + 1, user_data) == 0)
 				return 1;
 		}
 	}
@@ -612,10 +752,10 @@ TMTag **tm_tags_find(const GPtrArray *tags_array, const char *name,
 	tag = g_new0(TMTag, 1);
 	tag->name = (char *) name;
 
-	sort_options.sort_attrs = NULL;
-	sort_options.partial = partial;
+	init_sort_options(&sort_options, NULL, partial);
 	sort_options.tags_array = tags_array;
 	sort_options.first = TRUE;
+	sort_options.name_len = name ? strlen(name) : 0;
 	first = (TMTag **)binary_search(&tag, tags_array->pdata, tags_array->len,
 			tag_search_cmp, &sort_options);
 
@@ -112,7 +112,8 @@ GType tm_tag_get_type(void) G_GNUC_CONST;
 
 TMTag *tm_tag_new(void);
 
-void tm_tags_remove_file_tags(TMSourceFile *source_file, GPtrArray *tags_array);
+void tm_tags_remove_file_tags(TMSourceFile *source_file, GPtrArray *file_tags,
+	GPtrArray *tags_array);
 
 GPtrArray *tm_tags_merge(GPtrArray *big_array, GPtrArray *small_array, 
 	TMTagAttrType *sort_attributes, gboolean unref_duplicates);
@@ -67,6 +67,16 @@ static TMTagType TM_GLOBAL_TYPE_MASK =
 
 static TMWorkspace *theWorkspace = NULL;
 
+/* Tags of theWorkspace->tags_array and theWorkspace->global_tags by their scope, so the
+ * members of a type can be found without scanning all tags. Each maps a scope string
+ * to a GPtrArray of the tags in it, in no particular order. NULL until first needed. */
+static GHashTable *workspace_scope_index = NULL;
+static GHashTable *global_scope_index = NULL;
+
+/* time spent merging tags into the workspace arrays, for tm_workspace_get_statistics() */
+static gint64 merge_time = 0;
+static guint merge_count = 0;
+
 
 static gboolean tm_create_workspace(void)
 {
@@ -85,6 +95,105 @@ static gboolean tm_create_workspace(void)
 }
 
 
+static void scope_index_add(GHashTable *index, const GPtrArray *tags)
+{
+	guint i;
+
+	for (i = 0; i < tags->len; i++)
+	{
+		TMTag *tag = tags->pdata[i];
+		GPtrArray *scope_tags;
+
+		if (!tag->scope || tag->scope[0] == '\0')
+			continue;
+
+		scope_tags = g_hash_table_lookup(index, tag->scope);
+		if (!scope_tags)
+		{
+			scope_tags = g_ptr_array_new();
+			g_hash_table_insert(index, g_strdup(tag->scope), scope_tags);
+		}
+		g_ptr_array_add(scope_tags, tag);
+	}
+}
+
+
+/* Removes the tags of source_file from index, which must happen while they still exist */
+static void scope_index_remove_file(GHashTable *index, TMSourceFile *source_file,
+	GPtrArray *file_tags)
+{
+	GHashTable *scopes;
+	GHashTableIter iter;
+	gpointer scope;
+	guint i;
+
+	if (!index)
+		return;
+
+	/* each scope is filtered once, even if the file has many tags in it */
+	scopes = g_hash_table_new(g_str_hash, g_str_equal);
+	for (i = 0; i < file_tags->len; i++)
+	{
+		TMTag *tag = file_tags->pdata[i];
+
+		if (tag->scope && tag->scope[0] != '\0')
+			g_hash_table_add(scopes, tag->scope);
+	}
+
+	g_hash_table_iter_init(&iter, scopes);
+	while (g_hash_table_iter_next(&iter, &scope, NULL))
+	{
+		GPtrArray *scope_tags = g_hash_table_lookup(index, scope);
+		guint j = 0;
+
+		if (!scope_tags)
+			continue;
+
+		for (i = 0; i < scope_tags->len; i++)
+		{
+			TMTag *tag = scope_tags->pdata[i];
+
+			if (tag->file != source_file)
+				scope_tags->pdata[j++] = tag;
+		}
+		g_ptr_array_set_size(scope_tags, j);
+		if (j == 0)
+			g_hash_table_remove(index, scope);
+	}
+	g_hash_table_destroy(scopes);
+}
+
+
+static void scope_index_free(GHashTable **index)
+{
+	if (*index)
+		g_hash_table_destroy(*index);
+	*index = NULL;
+}
+
+
+/* Returns the scope index of tags_array if it has one, creating it if needed */
+static GHashTable *get_scope_index(const GPtrArray *tags_array)
+{
+	GHashTable **index;
+
+	if (tags_array == theWorkspace->tags_array)
+		index = &workspace_scope_index;
+	else if (tags_array == theWorkspace->global_tags)
+		index = &global_scope_index;
+	else
+		return NULL;
+
+	if (!*index)
+	{
+		*index = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify) g_ptr_array_unref);
+		scope_index_add(*index, tags_array);
+	}
+	return *index;
+}
+
+
 /* Frees the workspace structure and all child source files. Use only when
  exiting from the main program.
 */
@@ -99,6 +208,8 @@ void tm_workspace_free(void)
 	for (i=0; i < theWorkspace->source_files->len; ++i)
 		tm_source_file_free(theWorkspace->source_files->pdata[i]);
 	g_ptr_array_free(theWorkspace->source_files, TRUE);
+	scope_index_free(&workspace_scope_index);
+	scope_index_free(&global_scope_index);
 	tm_tags_array_free(theWorkspace->global_tags, TRUE);
 	g_ptr_array_free(theWorkspace->tags_array, TRUE);
 	g_ptr_array_free(theWorkspace->typename_array, TRUE);
@@ -141,30 +252,86 @@ static void merge_extracted_tags(GPtrArray **dest, GPtrArray *src, TMTagType tag
 }
 
 
+/* Removes the tags of source_file from the workspace, file_tags being the ones which
+ * were merged into it */
+static void remove_file_tags(TMSourceFile *source_file, GPtrArray *file_tags)
+{
+	scope_index_remove_file(workspace_scope_index, source_file, file_tags);
+	tm_tags_remove_file_tags(source_file, file_tags, theWorkspace->tags_array);
+	tm_tags_remove_file_tags(source_file, file_tags, theWorkspace->typename_array);
+}
+
+
+/* Whether the reparse kept exactly the tags of old_tags, which is the case when
+ * tm_source_file_parse() could reuse all of them and found no new ones */
+static gboolean file_tags_unchanged(GPtrArray *old_tags, GPtrArray *new_tags)
+{
+	GHashTable *old_table;
+	gboolean unchanged = TRUE;
+	guint i;
+
+	if (old_tags->len != new_tags->len)
+		return FALSE;
+
+	old_table = g_hash_table_new(g_direct_hash, g_direct_equal);
+	for (i = 0; i < old_tags->len; i++)
+		g_hash_table_add(old_table, old_tags->pdata[i]);
+	for (i = 0; i < new_tags->len && unchanged; i++)
+		unchanged = g_hash_table_contains(old_table, new_tags->pdata[i]);
+	g_hash_table_destroy(old_table);
+
+	return unchanged;
+}
+
+
 static void update_source_file(TMSourceFile *source_file, guchar* text_buf,
 	gsize buf_size, gboolean use_buffer, gboolean update_workspace)
 {
+	GPtrArray *old_tags = NULL;
+
 #ifdef TM_DEBUG
 	g_message("Source file updating based on source file %s", source_file->file_name);
 #endif
 
 	if (update_workspace)
 	{
-		/* tm_source_file_parse() deletes the tag objects - remove the tags from
-		 * workspace while they exist and can be scanned */
-		tm_tags_remove_file_tags(source_file, theWorkspace->tags_array);
-		tm_tags_remove_file_tags(source_file, theWorkspace->typename_array);
+		guint i;
+
+		/* tm_source_file_parse() releases the tags it doesn't reuse - keep them alive
+		 * so they can still be scanned when removing them from the workspace */
+		old_tags = g_ptr_array_sized_new(source_file->tags_array->len);
+		for (i = 0; i < source_file->tags_array->len; i++)
+			g_ptr_array_add(old_tags, tm_tag_ref(source_file->tags_array->pdata[i]));
 	}
 	tm_source_file_parse(source_file, text_buf, buf_size, use_buffer);
 	tm_tags_sort(source_file->tags_array, file_tags_sort_attrs, FALSE, TRUE);
 	if (update_workspace)
 	{
+		gint64 start_time = g_get_monotonic_time();
+
+		if (file_tags_unchanged(old_tags, source_file->tags_array))
+		{
+#ifdef TM_DEBUG
+			g_message("Tags unchanged, skipping workspace update");
+#endif
+			tm_tags_array_free(old_tags, TRUE);
+			return;
+		}
+
 #ifdef TM_DEBUG
 		g_message("Updating workspace from source file");
 #endif
+		remove_file_tags(source_file, old_tags);
+		tm_tags_array_free(old_tags, TRUE);
+
 		tm_workspace_merge_tags(&theWorkspace->tags_array, source_file->tags_array);
+		if (workspace_scope_index)
+			scope_index_add(workspace_scope_index, source_file->tags_array);
 
 		merge_extracted_tags(&(theWorkspace->typename_array), source_file->tags_array, TM_GLOBAL_TYPE_MASK);
+
+		merge_time += g_get_monotonic_time() - start_time;
+		merge_count++;
 	}
 #ifdef TM_DEBUG
 	else
@@ -231,8 +398,7 @@ void tm_workspace_remove_source_file(TMSourceFile *source_file)
 	{
 		if (theWorkspace->source_files->pdata[i] == source_file)
 		{
-			tm_tags_remove_file_tags(source_file, theWorkspace->tags_array);
-			tm_tags_remove_file_tags(source_file, theWorkspace->typename_array);
+			remove_file_tags(source_file, source_file->tags_array);
 			g_ptr_array_remove_index_fast(theWorkspace->source_files, i);
 			return;
 		}
@@ -249,12 +415,14 @@ static void tm_workspace_update(void)
 {
 	guint i, j;
 	TMSourceFile *source_file;
+	gint64 start_time = g_get_monotonic_time();
 
 #ifdef TM_DEBUG
 	g_message("Recreating workspace tags array");
 #endif
 
 	g_ptr_array_set_size(theWorkspace->tags_array, 0);
+	scope_index_free(&workspace_scope_index);
 
 #ifdef TM_DEBUG
 	g_message("Total %d objects", theWorkspace->source_files->len);
@@ -281,6 +449,9 @@ static void tm_workspace_update(void)
 
 	g_ptr_array_free(theWorkspace->typename_array, TRUE);
 	theWorkspace->typename_array = tm_tags_extract(theWorkspace->tags_array, TM_GLOBAL_TYPE_MASK);
+
+	merge_time += g_get_monotonic_time() - start_time;
+	merge_count++;
 }
 
 
@@ -340,21 +511,32 @@ void tm_workspace_remove_source_files(GPtrArray *source_files)
 }
 
 
-/* Loads the global tag list from the specified file. The global tag list should
- have been first created using tm_workspace_create_global_tags().
+/* Reads and sorts the tags of a global tags file. This doesn't touch the workspace so it
+ can be called from any thread, the tags are then added with tm_workspace_add_global_tags().
  @param tags_file The file containing global tags.
- @return TRUE on success, FALSE on failure.
- @see tm_workspace_create_global_tags()
+ @return The sorted tags, or NULL on failure.
 */
-gboolean tm_workspace_load_global_tags(const char *tags_file, TMParserType mode)
+GPtrArray *tm_workspace_read_global_tags(const char *tags_file, TMParserType mode)
 {
-	GPtrArray *file_tags, *new_tags;
+	GPtrArray *file_tags;
 
 	file_tags = tm_source_file_read_tags_file(tags_file, mode);
-	if (!file_tags)
-		return FALSE;
+	if (file_tags)
+		tm_tags_sort(file_tags, global_tags_sort_attrs, TRUE, TRUE);
+
+	return file_tags;
+}
 
-	tm_tags_sort(file_tags, global_tags_sort_attrs, TRUE, TRUE);
+
+/* Merges tags read by tm_workspace_read_global_tags() into the global tag list.
+ @param file_tags The tags to add, the array is freed.
+*/
+void tm_workspace_add_global_tags(GPtrArray *file_tags)
+{
+	GPtrArray *new_tags;
+	gint64 start_time = g_get_monotonic_time();
+
+	g_return_if_fail(file_tags != NULL);
 
 	/* reorder the whole array, because tm_tags_find expects a sorted array */
 	new_tags = tm_tags_merge(theWorkspace->global_tags, 
@@ -362,10 +544,32 @@ gboolean tm_workspace_load_global_tags(const char *tags_file, TMParserType mode)
 	g_ptr_array_free(theWorkspace->global_tags, TRUE);
 	g_ptr_array_free(file_tags, TRUE);
 	theWorkspace->global_tags = new_tags;
+	/* duplicates may have been freed by the merge, rebuild the index when needed */
+	scope_index_free(&global_scope_index);
 
 	g_ptr_array_free(theWorkspace->global_typename_array, TRUE);
 	theWorkspace->global_typename_array = tm_tags_extract(new_tags, TM_GLOBAL_TYPE_MASK);
 
+	merge_time += g_get_monotonic_time() - start_time;
+	merge_count++;
+}
+
+
+/* Loads the global tag list from the specified file. The global tag list should
+ have been first created using tm_workspace_create_global_tags().
+ @param tags_file The file containing global tags.
+ @return TRUE on success, FALSE on failure.
+ @see tm_workspace_create_global_tags()
+*/
+gboolean tm_workspace_load_global_tags(const char *tags_file, TMParserType mode)
+{
+	GPtrArray *file_tags;
+
+	file_tags = tm_workspace_read_global_tags(tags_file, mode);
+	if (!file_tags)
+		return FALSE;
+
+	tm_workspace_add_global_tags(file_tags);
 	return TRUE;
 }
 
@@ -420,39 +624,6 @@ static gboolean write_includes_file(const gchar *outf, GList *includes_files)
 }
 
 
-static gboolean combine_include_files(const gchar *outf, GList *file_list)
-{
-	FILE *fp = g_fopen(outf, "w");
-	GList *node = file_list;
-
-	if (!fp)
-		return FALSE;
-
-	while (node)
-	{
-		const char *fname = node->data;
-		char *contents;
-		size_t length;
-		GError *err = NULL;
-
-		if (! g_file_get_contents(fname, &contents, &length, &err))
-		{
-			fprintf(stderr, "Unable to read file: %s\n", err->message);
-			g_error_free(err);
-		}
-		else
-		{
-			fwrite(contents, length, 1, fp);
-			fwrite("\n", 1, 1, fp);	/* in case file doesn't end in newline (e.g. windows). */
-			g_free(contents);
-		}
-		node = g_list_next (node);
-	}
-
-	return fclose(fp) == 0;
-}
-
-
 static gchar *create_temp_file(const gchar *tpl)
 {
 	gchar *name;
@@ -590,11 +761,167 @@ static gchar *pre_process_file(const gchar *cmd, const gchar *inf)
 	return outf;
 }
 
+static gsize get_tag_strings_size(const TMTag *tag)
+{
+	const gchar *strings[] = {tag->name, tag->arglist, tag->scope, tag->inheritance, tag->var_type};
+	gsize size = 0;
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS(strings); i++)
+	{
+		if (strings[i])
+			size += strlen(strings[i]) + 1;
+	}
+	return size;
+}
+
+
+static gint compare_parse_times(gconstpointer a, gconstpointer b)
+{
+	gint64 t1 = tm_source_file_get_parse_time(*((TMSourceFile **) a));
+	gint64 t2 = tm_source_file_get_parse_time(*((TMSourceFile **) b));
+
+	if (t1 == t2)
+		return 0;
+	return t1 > t2 ? -1 : 1;
+}
+
+
+/* Returns a readable summary of the workspace: the tags per language, the memory used by
+ tags, their strings and the tag arrays, and the time spent parsing and merging.
+ @return The summary, to be freed with g_free().
+*/
+gchar *tm_workspace_get_statistics(void)
+{
+	const GPtrArray *tag_arrays[] = {theWorkspace->tags_array, theWorkspace->global_tags};
+	guint lang_counts[TM_PARSER_COUNT][G_N_ELEMENTS(tag_arrays)];
+	gsize tag_size = 0, strings_size = 0, arrays_size;
+	gint64 parse_time = 0;
+	GPtrArray *files;
+	GString *str;
+	guint i, j;
+
+	memset(lang_counts, 0, sizeof(lang_counts));
+	for (i = 0; i < G_N_ELEMENTS(tag_arrays); i++)
+	{
+		for (j = 0; j < tag_arrays[i]->len; j++)
+		{
+			TMTag *tag = tag_arrays[i]->pdata[j];
+
+			if (tag->lang >= 0 && tag->lang < TM_PARSER_COUNT)
+				lang_counts[tag->lang][i]++;
+			tag_size += sizeof(TMTag);
+			strings_size += get_tag_strings_size(tag);
+		}
+	}
+
+	/* the typename arrays and the files' arrays hold the same tags as the main arrays */
+	arrays_size = sizeof(gpointer) * (theWorkspace->tags_array->len +
+		theWorkspace->typename_array->len + theWorkspace->global_tags->len +
+		theWorkspace->global_typename_array->len + theWorkspace->source_files->len);
+	files = g_ptr_array_sized_new(theWorkspace->source_files->len);
+	for (i = 0; i < theWorkspace->source_files->len; i++)
+	{
+		TMSourceFile *source_file = theWorkspace->source_files->pdata[i];
+
+		arrays_size += sizeof(gpointer) * source_file->tags_array->len;
+		parse_time += tm_source_file_get_parse_time(source_file);
+		g_ptr_array_add(files, source_file);
+	}
+
+	str = g_string_new(NULL);
+	g_string_append_printf(str, "%u source files, %u tags, %u global tags\n",
+		theWorkspace->source_files->len, theWorkspace->tags_array->len,
+		theWorkspace->global_tags->len);
+	for (i = 0; i < TM_PARSER_COUNT; i++)
+	{
+		if (lang_counts[i][0] > 0 || lang_counts[i][1] > 0)
+			g_string_append_printf(str, "  %s: %u tags, %u global tags\n",
+				tm_source_file_get_lang_name(i), lang_counts[i][0], lang_counts[i][1]);
+	}
+	g_string_append_printf(str, "Memory: %" G_GSIZE_FORMAT " KiB in tags, %" G_GSIZE_FORMAT
+		" KiB in strings, %" G_GSIZE_FORMAT " KiB in arrays\n",
+		tag_size / 1024, strings_size / 1024, arrays_size / 1024);
+	g_string_append_printf(str, "Parsing: %.1f ms for the last parse of all files\n",
+		parse_time / 1000.0);
+
+	/* the files that took longest, listing all of a big project would be too much */
+	g_ptr_array_sort(files, compare_parse_times);
+	for (i = 0; i < files->len && i < 10; i++)
+	{
+		TMSourceFile *source_file = files->pdata[i];
+
+		g_string_append_printf(str, "  %.1f ms: %s\n",
+			tm_source_file_get_parse_time(source_file) / 1000.0, source_file->file_name);
+	}
+	g_ptr_array_free(files, TRUE);
+
+	g_string_append_printf(str, "Merging: %.1f ms in %u merges", merge_time / 1000.0, merge_count);
+
+	return g_string_free(str, FALSE);
+}
+
+
+/* Parses each of the include files on its own and merges their sorted tags, so that
+ without a preprocessor no combined temporary file has to be written and parsed */
+static GPtrArray *parse_include_files(GList *includes_files, TMParserType lang)
+{
+	GPtrArray *file_arrays = g_ptr_array_new();
+	GPtrArray *tags;
+	GList *node;
+	guint i;
+
+	for (node = includes_files; node; node = g_list_next(node))
+	{
+		TMSourceFile *source_file = tm_source_file_new(node->data, tm_source_file_get_lang_name(lang));
+
+		if (!source_file)
+			continue;
+		tm_source_file_parse(source_file, NULL, 0, FALSE);
+
+		/* take over the tags so they survive the source file */
+		tags = source_file->tags_array;
+		source_file->tags_array = g_ptr_array_new();
+		tm_source_file_free(source_file);
+		for (i = 0; i < tags->len; i++)
+			TM_TAG(tags->pdata[i])->file = NULL;
+
+		tm_tags_sort(tags, global_tags_sort_attrs, TRUE, TRUE);
+		g_ptr_array_add(file_arrays, tags);
+	}
+
+	/* merge the arrays pairwise so each tag only takes part in log(files) merges */
+	while (file_arrays->len > 1)
+	{
+		GPtrArray *merged = g_ptr_array_sized_new(file_arrays->len / 2 + 1);
+
+		for (i = 0; i + 1 < file_arrays->len; i += 2)
+		{
+			GPtrArray *a = file_arrays->pdata[i];
+			GPtrArray *b = file_arrays->pdata[i + 1];
+
+			g_ptr_array_add(merged, tm_tags_merge(a, b, global_tags_sort_attrs, TRUE));
+			g_ptr_array_free(a, TRUE);
+			g_ptr_array_free(b, TRUE);
+		}
+		if (i < file_arrays->len)
+			g_ptr_array_add(merged, file_arrays->pdata[i]);
+
+		g_ptr_array_free(file_arrays, TRUE);
+		file_arrays = merged;
+	}
+
+	tags = file_arrays->len > 0 ? file_arrays->pdata[0] : g_ptr_array_new();
+	g_ptr_array_free(file_arrays, TRUE);
+	return tags;
+}
+
 /* Creates a list of global tags. Ideally, this should be created once during
  installations so that all users can use the same file. This is because a full
  scale global tag list can occupy several megabytes of disk space.
  @param pre_process The pre-processing command. This is executed via system(),
  so you can pass stuff like 'gcc -E -dD -P `gnome-config --cflags gnome`'.
+ If NULL, each include file is parsed on its own and the tags of all files merged.
  @param includes Include files to process. Wildcards such as '/usr/include/a*.h'
  are allowed.
  @param tags_file The file where the tags will be stored.
@@ -607,39 +934,44 @@ gboolean tm_workspace_create_global_tags(const char *pre_process, const char **i
 	gboolean ret = FALSE;
 	TMSourceFile *source_file;
 	GList *includes_files;
-	gchar *temp_file = create_temp_file("tmp_XXXXXX.cpp");
+	gchar *temp_file, *temp_file2;
 
+	includes_files = lookup_includes(includes, includes_count);
+
+	if (!pre_process)
+	{
+		GPtrArray *tags = parse_include_files(includes_files, lang);
+
+		g_list_free_full(includes_files, g_free);
+		if (tags->len > 0)
+			ret = tm_source_file_write_tags_file(tags_file, tags);
+		tm_tags_array_free(tags, TRUE);
+		return ret;
+	}
+
+	temp_file = create_temp_file("tmp_XXXXXX.cpp");
 	if (!temp_file)
+	{
+		g_list_free_full(includes_files, g_free);
 		return FALSE;
-
-	includes_files = lookup_includes(includes, includes_count);
+	}
 
 #ifdef TM_DEBUG
 	g_message ("writing out files to %s\n", temp_file);
 #endif
-	if (pre_process)
-		ret = write_includes_file(temp_file, includes_files);
-	else
-		ret = combine_include_files(temp_file, includes_files);
+	ret = write_includes_file(temp_file, includes_files);
 
 	g_list_free_full(includes_files, g_free);
 	if (!ret)
 		goto cleanup;
 	ret = FALSE;
 
-	if (pre_process)
-	{
-		gchar *temp_file2 = pre_process_file(pre_process, temp_file);
-
-		if (temp_file2)
-		{
-			g_unlink(temp_file);
-			g_free(temp_file);
-			temp_file = temp_file2;
-		}
-		else
-			goto cleanup;
-	}
+	temp_file2 = pre_process_file(pre_process, temp_file);
+	if (!temp_file2)
+		goto cleanup;
+	g_unlink(temp_file);
+	g_free(temp_file);
+	temp_file = temp_file2;
 
 	source_file = tm_source_file_new(temp_file, tm_source_file_get_lang_name(lang));
 	if (!source_file)
@@ -771,6 +1103,8 @@ find_scope_members_tags (const GPtrArray *all, TMTag *type_tag, gboolean namespa
 {
 	TMTagType member_types = tm_tag_max_t & ~(TM_TYPE_WITH_MEMBERS | tm_tag_typedef_t);
 	GPtrArray *tags = g_ptr_array_new();
+	GHashTable *index = get_scope_index(all);
+	const GPtrArray *candidates = all;
 	gchar *scope;
 	guint i;
 
@@ -782,9 +1116,21 @@ find_scope_members_tags (const GPtrArray *all, TMTag *type_tag, gboolean namespa
 	else
 		scope = g_strdup(type_tag->name);
 
-	for (i = 0; i < all->len; ++i)
+	/* the workspace and global tags only need to look at the tags in scope */
+	if (index)
 	{
-		TMTag *tag = TM_TAG (all->pdata[i]);
+		candidates = g_hash_table_lookup(index, scope);
+		if (!candidates)
+		{
+			g_free(scope);
+			g_ptr_array_free(tags, TRUE);
+			return NULL;
+		}
+	}
+
+	for (i = 0; i < candidates->len; ++i)
+	{
+		TMTag *tag = TM_TAG (candidates->pdata[i]);
 
 		if (tag && (tag->type & member_types) &&
 			tag->scope && tag->scope[0] != '\0' &&
@@ -804,6 +1150,11 @@ find_scope_members_tags (const GPtrArray *all, TMTag *type_tag, gboolean namespa
 		return NULL;
 	}
 
+	/* return them in the same order as scanning all would */
+	if (index)
+		tm_tags_sort(tags, all == theWorkspace->global_tags ?
+			global_tags_sort_attrs : workspace_tags_sort_attrs, FALSE, FALSE);
+
 	return tags;
 }
 
@@ -49,6 +49,12 @@ const TMWorkspace *tm_get_workspace(void);
 
 gboolean tm_workspace_load_global_tags(const char *tags_file, TMParserType mode);
 
+GPtrArray *tm_workspace_read_global_tags(const char *tags_file, TMParserType mode);
+
+void tm_workspace_add_global_tags(GPtrArray *file_tags);
+
+gchar *tm_workspace_get_statistics(void);
+
 gboolean tm_workspace_create_global_tags(const char *pre_process, const char **includes,
 	int includes_count, const char *tags_file, TMParserType lang);
 
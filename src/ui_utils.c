@@ -914,6 +914,7 @@ static void init_document_widgets(void)
 	add_doc_widget("find_prevsel1");
 	add_doc_widget("find_usage1");
 	add_doc_widget("find_document_usage1");
+	add_doc_widget("find_workspace_usage1");
 	add_doc_widget("mark_all1");
 	add_doc_widget("go_to_line1");
 	add_doc_widget("goto_tag_definition1");